@@ -0,0 +1,168 @@
+#ifndef TASKFRAMEWORK_AGENTBEHAVIOR_HPP
+#define TASKFRAMEWORK_AGENTBEHAVIOR_HPP
+
+#include <coroutine>
+#include <cstddef>
+#include <map>
+#include <utility>
+#include <vector>
+
+// 协程帧池：按 64 字节分级的空闲链表，整块（slab）向系统申请，帧释放后回到本池复用。
+// 每个块前 16 字节记录所属池与级别，operator delete 据此归还；非池分配的帧记空指针。
+// 池不加锁，只能由持有它的 Simulator 所在线程使用。
+class FramePool {
+public:
+	FramePool() {}
+	~FramePool();
+	FramePool(const FramePool&) = delete;
+	FramePool& operator=(const FramePool&) = delete;
+
+	static void* allocateFrom(FramePool* pool, std::size_t n);
+	static void release(void* frame);
+
+	std::size_t allocations() const { return allocations_; }
+	std::size_t slabs() const { return slabs_.size(); }
+
+private:
+	void* allocate(std::size_t n);
+	void deallocate(void* block, std::size_t cls);
+
+	std::vector<std::vector<void*> > free_; // 级别 -> 空闲块
+	std::vector<void*> slabs_;
+	std::size_t allocations_ = 0;
+};
+
+// 行为执行阶段：与轮询模式的分桶顺序一致（先移动，再采集、制作、建造）
+enum class Phase : int { Move = 0, Harvest = 1, Craft = 2, Build = 3 };
+
+// 可等待的世界事件
+enum class EventKind : int { None = 0, Item = 1, ResourcePoint = 2, Building = 3 };
+
+struct EventKey {
+	EventKind kind = EventKind::None;
+	int id = 0;
+	bool operator<(const EventKey& o) const { return kind != o.kind ? kind < o.kind : id < o.id; }
+};
+
+enum class WakeReason { Timer, Event };
+
+// 一个 agent 的一项任务：惰性启动，由 BehaviorScheduler 恢复；帧从所属对象的 framePool() 分配
+class Behavior {
+public:
+	struct promise_type {
+		template <class Owner, class... Args>
+		static void* operator new(std::size_t n, Owner& owner, Args&&...) { return FramePool::allocateFrom(&owner.framePool(), n); }
+		static void* operator new(std::size_t n) { return FramePool::allocateFrom(nullptr, n); }
+		static void operator delete(void* p, std::size_t) { FramePool::release(p); }
+
+		Behavior get_return_object() { return Behavior(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { throw; }
+	};
+
+	Behavior() {}
+	explicit Behavior(std::coroutine_handle<promise_type> h) : handle_(h) {}
+	Behavior(Behavior&& o) noexcept : handle_(o.handle_) { o.handle_ = nullptr; }
+	Behavior& operator=(Behavior&& o) noexcept {
+		if (this != &o) {
+			reset();
+			handle_ = o.handle_;
+			o.handle_ = nullptr;
+		}
+		return *this;
+	}
+	Behavior(const Behavior&) = delete;
+	Behavior& operator=(const Behavior&) = delete;
+	~Behavior() { reset(); }
+
+	bool valid() const { return static_cast<bool>(handle_); }
+	bool done() const { return !handle_ || handle_.done(); }
+	void resume() { handle_.resume(); }
+	void reset() {
+		if (handle_) handle_.destroy();
+		handle_ = nullptr;
+	}
+
+private:
+	std::coroutine_handle<promise_type> handle_;
+};
+
+struct BehaviorStats {
+	long long resumes = 0;
+	long long timer_wakes = 0;
+	long long event_wakes = 0;
+	long long started = 0;
+};
+
+// 协程调度：计时器按 tick 分桶，事件按 EventKey 登记等待者；每个 tick 按阶段、同阶段按 agent 编号
+// 恢复到期或被事件唤醒的协程，其余 agent 不做任何事。每次挂起分配新的 wait_id，
+// 计时与事件谁先到谁唤醒，另一方的登记随之作废。
+class BehaviorScheduler {
+public:
+	class Awaiter {
+	public:
+		Awaiter(BehaviorScheduler& s, std::size_t aid, int tick, Phase phase, EventKey a, EventKey b)
+		: s_(s), aid_(aid), tick_(tick), phase_(phase), a_(a), b_(b) {}
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<>) { s_.park(aid_, tick_, phase_, a_, b_); }
+		WakeReason await_resume() const { return s_.slots_[aid_].reason; }
+
+	private:
+		BehaviorScheduler& s_;
+		std::size_t aid_;
+		int tick_;
+		Phase phase_;
+		EventKey a_, b_;
+	};
+
+	void resize(std::size_t agents) { if (slots_.size() < agents) slots_.resize(agents); }
+	// 替换 agent 的当前行为，于 tick 的 Move 阶段首次恢复
+	void start(std::size_t aid, Behavior b, int tick);
+	void stop(std::size_t aid);
+
+	// 在 tick 的 phase 阶段恢复；tick 不晚于当前阶段时顺延到下一 tick
+	Awaiter at(std::size_t aid, int tick, Phase phase) { return Awaiter(*this, aid, tick, phase, EventKey(), EventKey()); }
+	// 到时（tick < 0 表示不限时）或任一事件发生时恢复，事件唤醒落在其后最近的 phase 阶段
+	Awaiter until(std::size_t aid, int tick, Phase phase, EventKey a, EventKey b = EventKey()) {
+		return Awaiter(*this, aid, tick, phase, a, b);
+	}
+	void signal(EventKey key, int tick);
+
+	void runTick(int t);
+	int now() const { return now_; }
+
+	FramePool& framePool() { return pool_; }
+	const FramePool& framePool() const { return pool_; }
+	const BehaviorStats& stats() const { return stats_; }
+
+private:
+	struct Slot {
+		Behavior behavior;
+		unsigned wait_id = 0;
+		bool waiting = false;
+		Phase phase = Phase::Move;
+		WakeReason reason = WakeReason::Timer;
+	};
+	struct Wake {
+		std::size_t aid;
+		unsigned wait_id;
+		Phase phase;
+		WakeReason reason;
+	};
+
+	void park(std::size_t aid, int tick, Phase phase, EventKey a, EventKey b);
+	void schedule(const Wake& w, int tick);
+
+	FramePool pool_; // 先于 slots_ 构造、后于其析构：帧归还时池仍在
+	std::vector<Slot> slots_;
+	std::map<int, std::vector<Wake> > timers_;
+	std::map<EventKey, std::vector<std::pair<std::size_t, unsigned> > > waiters_;
+	std::vector<std::vector<Wake> > queue_; // 当前 tick 各阶段待恢复
+	int now_ = -1;
+	int phase_ = -1; // 正在处理的阶段，-1 表示不在 runTick 内
+	BehaviorStats stats_;
+};
+
+#endif
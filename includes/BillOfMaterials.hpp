@@ -0,0 +1,36 @@
+#ifndef TASKFRAMEWORK_BILLOFMATERIALS_HPP
+#define TASKFRAMEWORK_BILLOFMATERIALS_HPP
+
+#include "objects.hpp"
+#include <map>
+#include <vector>
+
+// 多级物料清单：由 CraftingSystem 一次性构建，配方查找为一次 map 查找，
+// 展开为按层级的一趟稀疏累加（各级按批量取整），不再递归走任务树
+class BillOfMaterials {
+public:
+	BillOfMaterials() {}
+	explicit BillOfMaterials(const CraftingSystem& crafting) { build(crafting); }
+	void build(const CraftingSystem& crafting);
+
+	// 产出该物品的配方（与任务树展开规则一致：crafting_id 最小者），无则为原料
+	const CraftingRecipe* recipeFor(int item_id) const;
+	// 物品层级：原料 0，成品 = 1 + 材料最大层级
+	int level(int item_id) const;
+	// 一批产出的完整展开（所有中间品与原料，不含自身），预计算
+	const std::map<int, int>& perBatch(int item_id) const;
+
+	// qty 个 item 的完整展开，累加到 out（不含 item 自身）
+	void explode(int item_id, int qty, std::map<int, int>& out) const;
+	// 净需求（MRP）：gross 为各物品的毛需求，on_hand 为库存+在制，
+	// 按层级自上而下扣减并把不足部分按批展开到材料；返回每个物品的净缺口（> 0）
+	std::map<int, int> netRequirements(std::map<int, int> gross, const std::map<int, int>& on_hand) const;
+
+private:
+	std::map<int, CraftingRecipe> recipe_of_;         // product item -> recipe
+	std::map<int, int> level_;
+	std::map<int, std::map<int, int> > per_batch_;
+	std::vector<int> order_;                          // 物品按层级从高到低
+};
+
+#endif
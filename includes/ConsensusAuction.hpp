@@ -0,0 +1,51 @@
+#ifndef TASKFRAMEWORK_CONSENSUSAUCTION_HPP
+#define TASKFRAMEWORK_CONSENSUSAUCTION_HPP
+
+#include <string>
+#include <vector>
+
+// 组间通信拓扑
+enum class ConsensusTopology { Full, Ring, Line, Star };
+
+bool parseConsensusTopology(const std::string& name, ConsensusTopology& out);
+
+struct ConsensusConfig {
+	int groups = 0;        // agent 分组数（每组一个线程）；0 表示不用去中心化竞价
+	ConsensusTopology topology = ConsensusTopology::Full;
+	double loss = 0.0;     // 每条消息的丢失概率
+	int max_delay = 0;     // 每条消息额外延迟 [0, max_delay] 轮
+	int max_rounds = 200;  // 超过仍未一致则按各组已知的最高出价收尾
+	int bundle_limit = 5;  // 每个 agent 的 bundle 上限
+	unsigned seed = 1;
+};
+
+struct ConsensusStats {
+	int runs = 0;
+	int unconverged = 0;
+	int rounds_last = 0;
+	int rounds_max = 0;
+	long long rounds_total = 0;
+	long long messages = 0;   // 组间发送的消息数
+	long long entries = 0;    // 消息中携带的 (任务, 出价, 赢家) 条目数
+	long long lost = 0;
+	long long micros_total = 0; // 求解耗时（含线程启动）
+};
+
+// 去中心化 CBBA：agent 按下标连续分成 groups 组，每组一个线程，各组只维护本地的
+// 赢家表（task -> 最高出价与赢家）和组内 agent 的 bundle，组间只沿拓扑交换赢家表消息。
+// 每轮：收消息并做最大值合并（出价高者胜，同分 agent 编号小者胜），本组 agent 被超价的任务移出 bundle；
+// 组内 agent 依次贪心补满 bundle（只加自己能赢的任务）；把赢家表发给邻居（可丢失、可延迟）。
+// 出价与 bundle 内其他任务无关，赢家表只增不减，故在消息最终送达时必然收敛。
+// 轮次同步与收敛判定（各组无变化且赢家表一致）由屏障完成，只作为测量用，不传递分配数据。
+class ConsensusAuction {
+public:
+	explicit ConsensusAuction(const ConsensusConfig& config) : config_(config) {}
+
+	// bids[agent][task]，NaN 表示不出价。返回每个 agent 的 bundle（task 下标，按加入顺序）
+	std::vector<std::vector<int> > solve(const std::vector<std::vector<double> >& bids, ConsensusStats& stats) const;
+
+private:
+	ConsensusConfig config_;
+};
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef TASKFRAMEWORK_EVENTQUEUE_HPP
+#define TASKFRAMEWORK_EVENTQUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// 多生产者单消费者无锁队列：push 以 CAS 压入链表头，可在任意线程并发调用；
+// drain 一次摘下整条链表并反转为到达顺序（同一生产者的事件保持先后），只能由唯一的消费者调用。
+// 消费者不与生产者竞争节点，因此没有 ABA 问题。
+template <class T>
+class EventQueue {
+public:
+	EventQueue() : head_(nullptr) {}
+	~EventQueue() {
+		Node* n = head_.exchange(nullptr, std::memory_order_acquire);
+		while (n) {
+			Node* next = n->next;
+			delete n;
+			n = next;
+		}
+	}
+	EventQueue(const EventQueue&) = delete;
+	EventQueue& operator=(const EventQueue&) = delete;
+
+	void push(const T& value) {
+		Node* n = new Node{value, head_.load(std::memory_order_relaxed)};
+		while (!head_.compare_exchange_weak(n->next, n, std::memory_order_release, std::memory_order_relaxed)) {
+		}
+	}
+
+	// 取出当前全部事件追加到 out，返回条数
+	size_t drain(std::vector<T>& out) {
+		Node* n = head_.exchange(nullptr, std::memory_order_acquire);
+		Node* rev = nullptr;
+		while (n) {
+			Node* next = n->next;
+			n->next = rev;
+			rev = n;
+			n = next;
+		}
+		size_t count = 0;
+		while (rev) {
+			Node* next = rev->next;
+			out.push_back(std::move(rev->value));
+			delete rev;
+			rev = next;
+			++count;
+		}
+		return count;
+	}
+
+	bool empty() const { return head_.load(std::memory_order_acquire) == nullptr; }
+
+private:
+	struct Node {
+		T value;
+		Node* next;
+	};
+	std::atomic<Node*> head_;
+};
+
+#endif
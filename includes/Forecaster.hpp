@@ -0,0 +1,48 @@
+#ifndef TASKFRAMEWORK_FORECASTER_HPP
+#define TASKFRAMEWORK_FORECASTER_HPP
+
+#include "TaskTree.hpp"
+#include "WorldState.hpp"
+#include <map>
+#include <vector>
+
+// 单个 Build 节点（或全部建筑）的完工时间估计，单位 tick，从当前世界状态起算；-1 表示无法完成（缺资源点）
+struct BuildForecast {
+	int building_id = -1;  // -1 表示全部未完成建筑
+	int node_id = -1;
+	int critical_path = 0; // N 人下的最长依赖链（含未建成的工作台）；同一节点的批次可由多人并行
+	long long work = 0;    // 总工作量（tick·人）：采集 + 制作 + 建造 + 路程
+	int lower_bound = 0;   // max(关键路径, 工作量 / N, 资源点瓶颈)
+	int upper_bound = 0;   // 列表调度上界：(工作量 - 关键路径) / N + 关键路径
+};
+
+// 解析式完工预测：不跑 Simulator，只在任务树上按配方耗时、建造耗时、采集速率（20 tick 采 10 个）
+// 与曼哈顿路程估算，用于容量规划与估价参考
+class Forecaster {
+public:
+	Forecaster(const WorldState& world, const TaskTree& tree);
+
+	std::vector<BuildForecast> forecast(int workers) const; // 每个未完成建筑一条
+	BuildForecast forecastBuilding(int building_id, int workers) const;
+	BuildForecast forecastAll(int workers) const;
+
+	int nodeDuration(int id) const { return units_[id] * unit_ticks_[id] + travel_[id]; } // 单人完成该节点剩余部分的 tick 数（含路程）
+
+private:
+	BuildForecast estimate(const std::vector<int>& roots, int workers) const;
+	void collect(int id, std::vector<char>& seen, std::vector<int>& out) const;
+	int lanes(int id, int workers) const;
+	int finishOf(int id, int workers, std::vector<int>& finish) const;
+
+	const WorldState& world_;
+	const TaskTree& tree_;
+	std::vector<int> units_;          // 剩余批次（采集为 10 个一批，制作为配方批次，建造为 1）
+	std::vector<int> unit_ticks_;     // 每批耗时
+	std::vector<int> travel_;         // 从上游工作地点赶到本节点工作地点的路程
+	std::vector<int> workbench_;      // Craft 节点所需、尚未建成的工作台 Build 节点，-1 无
+	std::vector<char> unreachable_;   // 子树中有采不到的原料
+	std::map<int, int> build_node_;   // building_id -> Build 节点
+	std::map<int, int> rp_count_;     // 原料 item -> 仍有余量的资源点数
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef TASKFRAMEWORK_RESOURCESLOTS_HPP
+#define TASKFRAMEWORK_RESOURCESLOTS_HPP
+
+#include "objects.hpp"
+#include <cstddef>
+#include <map>
+#include <vector>
+
+// 资源点占用/预留表：按 resource_point_id 直接下标，每个资源点 capacity 个采集位，
+// 每个 agent 至多持有一个位置（分配时预留，离开、换任务或资源点枯竭时释放）。
+// 同物品的资源点另按 id 升序索引，找最近空位时只看该物品的资源点。
+class ResourceSlots {
+public:
+	void reset(const std::map<int, ResourcePoint>& points, int capacity) {
+		int max_id = -1;
+		for (std::map<int, ResourcePoint>::const_iterator it = points.begin(); it != points.end(); ++it) {
+			if (it->first > max_id) max_id = it->first;
+		}
+		capacity_.assign(max_id + 1, 0);
+		used_.assign(max_id + 1, 0);
+		by_item_.clear();
+		for (std::map<int, ResourcePoint>::const_iterator it = points.begin(); it != points.end(); ++it) {
+			if (it->first < 0) continue;
+			capacity_[it->first] = capacity > 0 ? capacity : 1;
+			by_item_[it->second.resource_item_id].push_back(it->first);
+		}
+		held_.assign(held_.size(), -1);
+	}
+	void resizeAgents(size_t agents) { if (held_.size() < agents) held_.resize(agents, -1); }
+
+	// 采集位数：全部资源点 / 单个资源点（至少 1，已持有者不受影响）
+	void setCapacity(int capacity) {
+		for (size_t i = 0; i < capacity_.size(); ++i) {
+			if (capacity_[i] > 0) capacity_[i] = capacity > 0 ? capacity : 1;
+		}
+	}
+	bool setCapacity(int rp_id, int capacity) {
+		if (!known(rp_id)) return false;
+		capacity_[rp_id] = capacity > 0 ? capacity : 1;
+		return true;
+	}
+	int capacity(int rp_id) const { return known(rp_id) ? capacity_[rp_id] : 0; }
+	int used(int rp_id) const { return known(rp_id) ? used_[rp_id] : 0; }
+	bool hasFree(int rp_id) const { return known(rp_id) && used_[rp_id] < capacity_[rp_id]; }
+	int heldBy(size_t aid) const { return aid < held_.size() ? held_[aid] : -1; }
+
+	// 已持有该点返回 true；满员返回 false（原位置保留）；否则释放原位置后占用
+	bool reserve(size_t aid, int rp_id) {
+		if (aid >= held_.size()) return false;
+		if (held_[aid] == rp_id) return true;
+		if (!hasFree(rp_id)) return false;
+		release(aid);
+		used_[rp_id]++;
+		held_[aid] = rp_id;
+		return true;
+	}
+	// 返回释放的资源点，未持有返回 -1
+	int release(size_t aid) {
+		if (aid >= held_.size() || held_[aid] < 0) return -1;
+		int rp_id = held_[aid];
+		used_[rp_id]--;
+		held_[aid] = -1;
+		return rp_id;
+	}
+
+	const std::vector<int>& pointsOf(int item_id) const {
+		static const std::vector<int> none;
+		std::map<int, std::vector<int> >::const_iterator it = by_item_.find(item_id);
+		return it != by_item_.end() ? it->second : none;
+	}
+
+private:
+	bool known(int rp_id) const { return rp_id >= 0 && rp_id < static_cast<int>(capacity_.size()) && capacity_[rp_id] > 0; }
+
+	std::vector<int> capacity_; // rp_id -> 采集位数，0 表示无此资源点
+	std::vector<int> used_;     // rp_id -> 已占用
+	std::vector<int> held_;     // agent -> 持有的资源点，-1 无
+	std::map<int, std::vector<int> > by_item_; // item_id -> 资源点 id（升序）
+};
+
+#endif
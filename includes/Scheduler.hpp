@@ -4,6 +4,8 @@
 #include "TaskTree.hpp"
 #include "objects.hpp"
 #include "WorldState.hpp"
+#include "BillOfMaterials.hpp"
+#include "ConsensusAuction.hpp"
 #include <vector>
 #include <string>
 #include <map>
@@ -14,6 +16,44 @@ struct WinInfo {
 	double score = -1e18;
 };
 
+// 估价与交易的可调参数，默认值即原先写死的常数；tools/PolicyTuner 在无头模拟中搜索更好的取值
+struct SchedulerPolicy {
+	double build_value = 1e6;       // 建造的基础价值
+	double craft_value = 1e4;       // 制作的基础价值
+	double craft_shortage = 100.0;  // 需工作台的制作：成品每件缺口的加价
+	double gather_shortage = 50.0;  // 采集：每件缺口的价值
+	double distance = 10.0;         // 每格距离的扣分
+	double unit_bonus = 20.0;       // 竞价时每个剩余批次的加分
+	double rank_scale = 20000.0;    // 向上秩尺度（tick）：value *= 1 + rank / scale；<= 0 关闭
+	double trade_min_gain = 50.0;   // bundle 交易的最小增益
+	double trade_cooldown = 50.0;   // 同一任务两次交易的最小间隔（tick）
+};
+
+// 按名字读写策略参数（名字即字段名），供配置文件与调参工具使用；未知名字返回 false
+std::vector<std::pair<std::string, double> > policyParams(const SchedulerPolicy& policy);
+bool setPolicyParam(SchedulerPolicy& policy, const std::string& name, double value);
+
+// 修补式竞价的统计：全量竞价次数、修补次数、累计出价（scoreTask 调用）次数
+struct AuctionStats {
+	int full_auctions = 0;
+	int repairs = 0;
+	long long bids = 0;
+};
+
+// 限时（anytime）竞价的统计：用时不含审计；score_full 只在开启审计时累计（未到期的调用与限时结果相同）
+struct AnytimeStats {
+	int runs = 0;
+	int truncated = 0;          // 到期返回的次数
+	bool last_truncated = false;
+	long long micros_total = 0;
+	long long micros_max = 0;
+	long long deferred = 0;     // 到期时尚未处理、顺延到下次的任务数（累计）
+	long long cached_bids = 0;  // 复用缓存的出价次数
+	int audits = 0;
+	double score = 0.0;         // 限时分配的出价总和
+	double score_full = 0.0;    // 同一输入不限时的出价总和
+};
+
 class Scheduler {
 public:
 	explicit Scheduler(WorldState& world);
@@ -29,19 +69,59 @@ public:
 	                                         const std::vector<int>& in_progress,
 	                                         int current_tick);
 
-	// 供外部简单估价使用（例如决定是否中断采集）
-	double publicScore(const TFNode& node, const Agent& ag, const std::map<int, int>& shortage) const {
-		return scoreTask(node, ag, shortage);
+	// 供外部简单估价使用（例如决定是否中断采集）；meta 给出 Build 节点的工地坐标，缺省用该类建筑的坐标
+	double publicScore(const TFNode& node, const Agent& ag, const std::map<int, int>& shortage, const TFNodeMeta* meta = nullptr) const {
+		return scoreTask(node, ag, shortage, meta);
 	}
 
+	// 变化量（变化任务数 + 变化 agent 数）超过 (候选任务 + 空闲 agent) 的该比例时退回全量竞价
+	void setRepairThreshold(double fraction) { repair_threshold_ = fraction; }
+	const AuctionStats& auctionStats() const { return stats_; }
+	// 估价中向上秩的尺度（tick）：value *= 1 + rank / scale；<= 0 关闭
+	void setRankScale(double ticks) { policy_.rank_scale = ticks; }
+	void setPolicy(const SchedulerPolicy& policy) { policy_ = policy; }
+	const SchedulerPolicy& policy() const { return policy_; }
+	// 去中心化 CBBA（见 ConsensusAuction.hpp）：groups > 0 时赢家由各组线程经消息达成一致，替代共享的 winners_
+	void setConsensus(const ConsensusConfig& config) { consensus_ = config; }
+	const ConsensusStats& consensusStats() const { return consensus_stats_; }
+	// 限时竞价：> 0 时按优先级逐任务贪心分配，墙钟用时（自 assign 入口起）到 micros 即返回已有分配，
+	// 未处理的任务下次优先；<= 0 关闭（默认，走修补式竞价）。audit 为真时到期的调用另跑一遍不限时的同一算法比较总分
+	void setAnytimeBudget(long long micros, bool audit = false) { anytime_budget_us_ = micros; anytime_audit_ = audit; }
+	const AnytimeStats& anytimeStats() const { return anytime_stats_; }
+
 private:
+	// 影响出价的任务侧输入；与上次不同则该任务需重新出价
+	struct TaskSig {
+		int units = 0;
+		int shortage = 0;
+		double weight = 1.0;
+		bool operator==(const TaskSig& o) const { return units == o.units && shortage == o.shortage && weight == o.weight; }
+	};
+	struct AgentSig {
+		bool idle = false;
+		int x = 0, y = 0;
+	};
+
 	WorldState& world_;
+	BillOfMaterials bom_;                     // 由配方一次性构建，缺口净算用
 	std::vector<std::vector<int> > bundles_; // 每个 agent 的 bundle
-	std::vector<WinInfo> winners_;           // task_id -> winner
+	std::vector<WinInfo> winners_;           // task_id -> winner，跨调用保留
 	std::vector<int> last_sort_tick_;        // 上次排序的 tick
-	std::vector<std::vector<std::pair<double,int> > > last_scores_; // 缓存上次排序得分
+	std::vector<std::vector<std::pair<double,int> > > last_scores_; // 缓存上次排序得分（跨调用修补）
+	std::map<int, TaskSig> last_sig_;        // 上次参与竞价的任务签名
+	std::vector<AgentSig> agent_sig_;        // 上次调用时各 agent 的状态
+	double repair_threshold_ = 0.3;
+	SchedulerPolicy policy_;
+	AuctionStats stats_;
+	ConsensusConfig consensus_;
+	ConsensusStats consensus_stats_;
+	long long anytime_budget_us_ = 0;
+	bool anytime_audit_ = false;
+	AnytimeStats anytime_stats_;
+	std::vector<std::map<int, double> > bid_cache_; // agent -> task_id -> 出价（限时模式跨调用复用）
+	std::vector<int> anytime_pending_;              // 上次到期时尚未处理的任务
 
-	double scoreTask(const TFNode& node, const Agent& ag, const std::map<int, int>& shortage) const;
+	double scoreTask(const TFNode& node, const Agent& ag, const std::map<int, int>& shortage, const TFNodeMeta* meta = nullptr) const;
 };
 
 #endif
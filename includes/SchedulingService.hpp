@@ -0,0 +1,68 @@
+#ifndef TASKFRAMEWORK_SCHEDULINGSERVICE_HPP
+#define TASKFRAMEWORK_SCHEDULINGSERVICE_HPP
+
+#include "ServiceProtocol.hpp"
+#include "WorldState.hpp"
+#include "TaskTree.hpp"
+#include "Scheduler.hpp"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class DatabaseManager;
+
+// 服务端延迟统计（微秒，收包到回包）
+struct LatencySummary {
+	size_t count = 0;
+	long long p50 = 0;
+	long long p90 = 0;
+	long long p99 = 0;
+	long long max = 0;
+};
+
+// 调度守护进程：在一个进程里托管多个相互独立的 WorldState/TaskTree/Scheduler 会话，
+// 经 Unix 域套接字接收世界增量与分配请求（协议见 ServiceProtocol.hpp）。
+// 在 batch_window_us 内到达的请求合成一批：会话创建/统计串行处理，各会话的增量与分配
+// 按到达顺序在工作线程池上并行（同一会话内串行），随后统一回包并销毁待删会话。
+class SchedulingService {
+public:
+	SchedulingService(DatabaseManager& db, int workers, int batch_window_us);
+	~SchedulingService();
+
+	bool listen(const std::string& socket_path);
+	void serve();                 // 阻塞，直到 stop()
+	void stop() { running_ = false; } // 可在信号处理或其他线程中调用
+	LatencySummary latency() const;
+	size_t sessionCount() const { return sessions_.size(); }
+
+private:
+	struct Session;
+	struct Connection;
+	struct Request;
+	class WorkerPool;
+
+	void acceptClients();
+	bool readClient(Connection& c, long long now_us);
+	void processBatch();
+	void handleSessionOps(Session& s, std::vector<Request*>& ops);
+	void applyDelta(Session& s, Request& req);
+	void assign(Session& s, Request& req);
+	void reply(Request& req);
+
+	DatabaseManager& db_;
+	int batch_window_us_;
+	std::unique_ptr<WorkerPool> pool_;
+	std::atomic<bool> running_;
+	int listen_fd_ = -1;
+	std::string socket_path_;
+	std::map<int, std::unique_ptr<Connection> > conns_; // fd -> 连接
+	std::map<uint32_t, std::unique_ptr<Session> > sessions_;
+	uint32_t next_session_ = 1;
+	std::vector<std::unique_ptr<Request> > batch_;
+	long long batch_start_us_ = 0;
+	std::vector<long long> latencies_us_;
+};
+
+#endif
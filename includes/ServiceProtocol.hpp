@@ -0,0 +1,94 @@
+#ifndef TASKFRAMEWORK_SERVICEPROTOCOL_HPP
+#define TASKFRAMEWORK_SERVICEPROTOCOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 调度服务的二进制协议（Unix 域流套接字，小端）。
+// 每帧 = 16 字节头 + payload；payload 全部是 int32 序列。
+//   头：u32 payload 长度、u16 op、u16 status、u32 request_id（客户端自定，原样带回）、u32 session_id
+//   Create  请求：width, height, agent_count            回复：空（session_id 在头中）
+//   Delta   请求：N × {kind, a, b, c}（见 DeltaKind）    回复：空
+//   Assign  请求：空                                     回复：M × {agent, node_id, type, target_id}
+//   Destroy 请求：空                                     回复：空
+//   Stats   请求：空                                     回复：count, p50, p90, p99, max（微秒，服务端收包到回包）
+// 回复帧 op = 请求 op | OpReply，status 见 Status。
+namespace svc {
+
+enum Op : uint16_t {
+	OpCreate = 1,
+	OpDelta = 2,
+	OpAssign = 3,
+	OpDestroy = 4,
+	OpStats = 5,
+	OpReply = 0x8000
+};
+
+enum Status : uint16_t {
+	StatusOk = 0,
+	StatusBadRequest = 1,
+	StatusNoSession = 2,
+	StatusFailed = 3
+};
+
+enum DeltaKind : int32_t {
+	DeltaItem = 1,         // a = item_id, b = 数量变化（可为负）
+	DeltaBuildingDone = 2, // a = building_id
+	DeltaAgentMove = 3,    // a = agent, b = x, c = y
+	DeltaAgentDone = 4     // a = agent：当前任务的这一批已结束，释放锁定并置空闲
+};
+
+const size_t kHeaderSize = 16;
+const uint32_t kMaxPayload = 1u << 20;
+
+struct FrameHeader {
+	uint32_t length = 0;
+	uint16_t op = 0;
+	uint16_t status = 0;
+	uint32_t request_id = 0;
+	uint32_t session_id = 0;
+};
+
+inline void putU32(std::vector<unsigned char>& out, uint32_t v) {
+	for (int i = 0; i < 4; ++i) out.push_back(static_cast<unsigned char>((v >> (8 * i)) & 0xff));
+}
+
+inline void putI32(std::vector<unsigned char>& out, int32_t v) {
+	putU32(out, static_cast<uint32_t>(v));
+}
+
+inline uint32_t getU32(const unsigned char* p) {
+	return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8)
+	     | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+inline int32_t getI32(const unsigned char* p) {
+	return static_cast<int32_t>(getU32(p));
+}
+
+// 写入头部（length 取 payload 大小）并追加 payload
+inline void encodeFrame(std::vector<unsigned char>& out, const FrameHeader& h, const std::vector<unsigned char>& payload) {
+	putU32(out, static_cast<uint32_t>(payload.size()));
+	out.push_back(static_cast<unsigned char>(h.op & 0xff));
+	out.push_back(static_cast<unsigned char>(h.op >> 8));
+	out.push_back(static_cast<unsigned char>(h.status & 0xff));
+	out.push_back(static_cast<unsigned char>(h.status >> 8));
+	putU32(out, h.request_id);
+	putU32(out, h.session_id);
+	out.insert(out.end(), payload.begin(), payload.end());
+}
+
+inline FrameHeader decodeHeader(const unsigned char* p) {
+	FrameHeader h;
+	h.length = getU32(p);
+	h.op = static_cast<uint16_t>(p[4] | (p[5] << 8));
+	h.status = static_cast<uint16_t>(p[6] | (p[7] << 8));
+	h.request_id = getU32(p + 8);
+	h.session_id = getU32(p + 12);
+	return h;
+}
+
+} // namespace svc
+
+#endif
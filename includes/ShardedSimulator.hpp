@@ -0,0 +1,83 @@
+#ifndef TASKFRAMEWORK_SHARDEDSIMULATOR_HPP
+#define TASKFRAMEWORK_SHARDEDSIMULATOR_HPP
+
+#include "WorldState.hpp"
+#include "TaskTree.hpp"
+#include "Scheduler.hpp"
+#include "Simulator.hpp"
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+class DatabaseManager;
+
+// 分片运行结果
+struct ShardBuild {
+	int shard;
+	int building_id;
+	int tick;
+};
+
+struct ShardStats {
+	int ticks = 0;            // 实际推进的 tick（全部分片完成即提前结束）
+	int epochs = 0;           // 屏障次数
+	long long items_moved = 0; // 经账本在分片间搬运的物品总数
+	int handoffs = 0;         // 移交给其他分片的 agent 数
+	std::vector<ShardBuild> builds;
+	std::map<int, int> ledger; // 结束时全局账本中的剩余物品
+};
+
+// 空间分片模拟：大地图按网格切成 K 个区域，每个区域一个独立的 WorldState/TaskTree/Scheduler/Simulator，
+// 区域 r 的内容用 CreateRandomWorld(width, height) 生成后平移到 (列 * width, 行 * height)。
+// 各分片在两次屏障之间（epoch 个 tick）互不通信，可在线程或子进程中并行推进；
+// 屏障处由协调者对账：各分片上报库存与需求量，先保留本地所需，余量进入全局账本，
+// 再按需求（起点轮转）从账本补给各分片，以库存增量下发。已完工的分片把 agent 移交给剩余工作最多的分片。
+// 线程模式与进程模式对同一输入给出相同结果。
+class ShardedSimulator {
+public:
+	ShardedSimulator(DatabaseManager& db, int shards, int region_width, int region_height, int agents_per_shard);
+	~ShardedSimulator();
+
+	void setEpoch(int ticks) { epoch_ = ticks < 1 ? 1 : ticks; }
+	// true：每个分片 fork 一个子进程，屏障消息经 socketpair 传递；false：每个 epoch 各分片一个线程
+	void setProcessMode(bool enabled) { process_mode_ = enabled; }
+
+	// 推进至多 max_ticks，所有分片完工即提前结束
+	ShardStats run(int max_ticks);
+
+	int shardCount() const { return static_cast<int>(shards_.size()); }
+
+	struct Report {
+		int shard = 0;
+		bool finished = false;
+		int remaining_buildings = 0;
+		int agents = 0;
+		std::map<int, int> inventory; // item_id -> 库存
+		std::map<int, int> want;      // item_id -> 任务图中仍挂着的需求量
+		std::vector<std::pair<int, int> > built;   // (building_id, tick)，自上次上报以来
+		std::vector<std::pair<int, int> > leaving; // 移交出去的 agent 坐标
+	};
+	struct Grant {
+		bool stop = false;
+		int ticks = 0;            // 本 epoch 推进的 tick 数
+		std::map<int, int> delta; // item_id -> 库存增量
+		std::vector<std::pair<int, int> > arriving; // 移交进来的 agent 坐标
+	};
+
+private:
+	struct Shard;
+
+	Report advance(Shard& s, const Grant& g); // 应用增量与移交，推进 g.ticks，上报
+	void reconcile(std::vector<Report>& reports, std::vector<Grant>& grants, ShardStats& stats);
+	void runThreads(int max_ticks, ShardStats& stats);
+	void runProcesses(int max_ticks, ShardStats& stats);
+
+	std::vector<std::unique_ptr<Shard> > shards_;
+	std::map<int, int> ledger_;
+	int epoch_ = 20;
+	int epoch_index_ = 0;
+	bool process_mode_ = false;
+};
+
+#endif
@@ -3,15 +3,145 @@
 
 #include "TaskTree.hpp"
 #include "Scheduler.hpp"
+#include "AgentBehavior.hpp"
+#include "EventQueue.hpp"
+#include "ResourceSlots.hpp"
 #include <vector>
 #include <string>
+#include <map>
+#include <fstream>
+#include <random>
+#include <future>
+#include <memory>
+#include <functional>
+
+// 后台重规划的统计：计划陈旧度（应用 tick - 快照 tick）与校验结果
+struct ReplanStats {
+	int plans = 0;
+	long long staleness_sum = 0;
+	int staleness_max = 0;
+	int accepted = 0;
+	int rejected = 0;
+};
+
+// 资源点预留统计：预留次数、因最近资源点满员改去次近空位的次数、在满员资源点旁等待的 agent·tick
+struct ResourceSlotStats {
+	long long reservations = 0;
+	long long redirects = 0;
+	long long wait_ticks = 0;
+};
+
+// 搬运统计：送达次数、送达物品数、其中送到消费地（工地/工作台）的次数
+struct HaulStats {
+	long long trips = 0;
+	long long items = 0;
+	long long to_consumer = 0;
+};
+
+// 模拟事件，供嵌入方回调：type 1 建成（target = building_id）、2 制作产出、3 采集（target = item_id）
+struct SimEvent {
+	int tick;
+	int type;
+	int agent;
+	int target_id;
+	int quantity;
+};
 
 class Simulator {
 public:
 	Simulator(WorldState& world, TaskTree& tree, Scheduler& scheduler, std::vector<Agent*>& agents);
-	void run(int ticks);
+	void run(int ticks); // begin + step(ticks) + finish
+
+	// 分段推进（嵌入用）：begin 一次（打开日志、写初始布局），之后任意次 step，最后 finish。
+	// agents 可在两次 step 之间追加，下一次 step 自动补齐其状态
+	bool begin();
+	void step(int ticks);
+	void finish();
+	int tick() const { return tick_; }
+	int currentTask(size_t aid) const { return aid < current_task_.size() ? current_task_[aid] : -1; }
+	// 日志文件路径，默认 Simulation.log；空串不写日志
+	void setLogPath(const std::string& path) { log_path_ = path; }
+	void setEventCallback(const std::function<void(const SimEvent&)>& cb) { on_event_ = cb; }
+
+	// 重规划节奏：事件触发的最小间隔；兜底全量重规划（中断检查 + 交易）的周期。单位 tick
+	void setReplanInterval(int min_interval, int full_interval);
+	// 后台线程在一致快照上做竞价分配，结果在之后的 tick 校验后应用；
+	// 计划最多滞后 max_lag 个 tick，超过则在该 tick 等待其完成
+	void setAsyncReplan(bool enabled, int max_lag = 2) { async_replan_ = enabled; async_max_lag_ = max_lag < 1 ? 1 : max_lag; }
+	const ReplanStats& replanStats() const { return replan_stats_; }
+	// 协程执行：每个 agent 的当前任务是一个协程，只在计时到期或等待的世界事件发生时恢复；
+	// 默认关闭（逐 tick 轮询），两者的任务语义一致
+	void setCoroutineAgents(bool enabled) { coroutine_agents_ = enabled; }
+	const BehaviorStats& behaviorStats() const { return behaviors_.stats(); }
+	// 资源点采集位：每点默认 1 个；开始采集任务时即预留最近的空位，满员则改去次近的有空位者
+	void setResourceSlots(int capacity) { slots_.setCapacity(capacity); }
+	ResourceSlots& resourceSlots() { return slots_; }
+	const ResourceSlotStats& slotStats() const { return slot_stats_; }
+	// 随身搬运：capacity > 0 时采集与制作的产出先放进 agent 的随身货物（每人至多 capacity 件），
+	// 装满、任务结束或换任务时送到最近的仓库（建筑 256）或消费地，送达才入库并记入任务树；0 关闭（默认）
+	void setCarryCapacity(int capacity);
+	const HaulStats& haulStats() const { return haul_stats_; }
+	// 运行时建造订单（在两次 step 之间调用）：增量插入任务树，下一次重规划即可分配；返回订单（工地）id，
+	// 无此建筑类型返回 -1。撤销时丢弃 bundle 与当前任务中对该子树的引用，已投入的材料不退还
+	int addBuildOrder(int building_type, int x, int y, double priority = 1.0);
+	bool cancelBuildOrder(int order);
 
 private:
+	friend struct Behavior::promise_type; // 协程帧从 framePool() 分配
+
+	// 后台重规划快照：tree/world/agent 的深拷贝 + 分配结果
+	struct ReplanJob {
+		ReplanJob(const WorldState& w, const TaskTree& t) : world(w), tree(t) {}
+		int tick = 0;
+		bool full = false;
+		WorldState world;
+		TaskTree tree;
+		std::vector<Agent> agents;
+		std::vector<Agent*> agent_ptrs;
+		std::vector<int> current_task;
+		std::vector<int> ready;
+		std::map<int, int> shortage;
+		std::vector<std::pair<int, int> > plan;
+	};
+
+	void replan(int t, const std::map<int, int>& shortage, bool full);
+	std::vector<int> prepareReplan(int t, const std::map<int, int>& shortage, bool full);
+	void applyPlan(int t, const std::vector<std::pair<int, int> >& plan, const std::map<int, int>& shortage, bool full);
+	void launchReplan(int t, const std::map<int, int>& shortage, bool full, const std::vector<int>& ready);
+	void collectReplan(int t, const std::map<int, int>& shortage);
+	void execute(int t);
+	// 执行者只把建成（类型 1）与产出（类型 2）压入 events_；每 tick 执行结束后由此统一入库、
+	// 更新任务树，并按一次算出的缺口做后续处理（日志、回调、置空闲）
+	void drainEvents(int t);
+	void dropFreedNodes(); // 惰性任务树释放子树后，丢弃 bundle 与当前任务中失效的节点 id
+	void logTick(int t);
+	void syncAgentSlots();
+	void emit(int t, int type, size_t aid, int target_id, int quantity);
+	// 采集目标：仍有存量的已预留资源点；否则预留最近的有空位者，全部满员时返回最近的有存量者（不预留）
+	ResourcePoint* targetResourcePoint(size_t aid, int item_id, int& dist);
+	bool claimResourcePoint(size_t aid, int rp_id);
+	void releaseResourcePoint(size_t aid);
+
+	// 协程模式：任务变化的 agent 在下一次 execute 时重建协程
+	void executeCoroutines(int t);
+	void noteTaskChange(size_t aid);
+	FramePool& framePool() { return behaviors_.framePool(); }
+	Behavior gatherBehavior(size_t aid, int tid);
+	Behavior craftBehavior(size_t aid, int tid);
+	Behavior buildBehavior(size_t aid, int tid);
+	Behavior haulBehavior(size_t aid);
+
+	// 搬运：有货且装满、任务已换或当前采集已够数时先送货；haulStep 走一步，到达后卸货并返回 true
+	bool needsHaul(size_t aid) const;
+	int gatherNeed(size_t aid, const TFNode& node) const; // 还要采的量：扣除随身已采的，且不超过剩余容量
+	bool haulStep(size_t aid);
+	std::pair<int, int> dropPoint(size_t aid, bool& consumer) const;
+
+	// 重规划事件：agent 变空闲、建造完成、缺口跨零、资源点枯竭或再生
+	void setIdle(size_t aid);
+	void markGatherers(int item_id); // item_id < 0 表示所有采集中的 agent
+	void noteShortageChanges(const std::map<int, int>& shortage);
+
 	WorldState& world_;
 	TaskTree& tree_;
 	Scheduler& scheduler_;
@@ -20,6 +150,38 @@ private:
 	std::vector<int> ticks_left_;
 	std::vector<int> harvested_since_leave_;
 	std::vector<int> current_batch_;
+	std::vector<int> harvest_rp_; // agent -> 最近一次采集的资源点（日志用）
+	EventQueue<TaskInfo> events_;
+
+	std::ofstream log_;
+	std::mt19937 rng_;
+	int replan_min_interval_;
+	int replan_full_interval_;
+	int last_replan_tick_;
+	int last_full_replan_tick_;
+	bool replan_pending_;
+	std::vector<char> replan_affected_; // agent -> 是否需要在下一次事件重规划中复查
+	std::map<int, int> last_shortage_;
+
+	bool async_replan_ = false;
+	int async_max_lag_ = 2;
+	std::unique_ptr<ReplanJob> job_;
+	std::future<void> job_done_;
+	ReplanStats replan_stats_;
+
+	bool coroutine_agents_ = false;
+	BehaviorScheduler behaviors_;
+	std::vector<size_t> respawn_;
+	ResourceSlots slots_;
+	ResourceSlotStats slot_stats_;
+
+	int carry_capacity_ = 0;
+	std::vector<std::pair<int, int> > storage_sites_; // 已建成仓库的坐标
+	HaulStats haul_stats_;
+
+	int tick_ = 0;
+	std::string log_path_ = "Simulation.log";
+	std::function<void(const SimEvent&)> on_event_;
 };
 
 #endif
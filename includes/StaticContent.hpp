@@ -0,0 +1,138 @@
+#ifndef TASKFRAMEWORK_STATICCONTENT_HPP
+#define TASKFRAMEWORK_STATICCONTENT_HPP
+
+#include "TaskTree.hpp"
+#include "objects.hpp"
+#include <map>
+#include <vector>
+
+// 编译期内容表的行类型。表本身由 ContentGen 从 game_data.db 生成（ShippedContent.hpp），
+// 只用于不会在运行时改动的发行内容；mod 内容仍走 DatabaseManager + CraftingSystem。
+struct StaticMaterial {
+	int item_id;
+	int quantity;
+};
+
+struct StaticItem {
+	int item_id;
+	const char* name;
+	int required_building_id;
+	bool is_resource;
+};
+
+template <int MaxMaterials>
+struct StaticRecipe {
+	int crafting_id;
+	int product_item_id;
+	int quantity_produced;
+	int production_time;
+	int required_building_id;
+	StaticMaterial materials[MaxMaterials]; // 未用槽位 quantity = 0
+};
+
+template <int MaxMaterials>
+struct StaticBuilding {
+	int building_id;
+	const char* name;
+	int construction_time;
+	StaticMaterial materials[MaxMaterials];
+};
+
+// 展开后的配方树（按建筑先序排列）；parent 为同表下标，-1 表示 Build 根
+struct StaticDagNode {
+	int parent;
+	int depth;
+	int type; // 0 Gather, 1 Craft, 2 Build（与 TaskType 顺序一致）
+	int item_id;
+	int crafting_id;
+	int building_id;
+	int demand;
+};
+
+// 基于编译期表的 CraftingSystem 变体：查配方是数组下标，材料遍历是定长循环
+template <class Content>
+class StaticCraftingSystem {
+public:
+	typedef StaticRecipe<Content::kMaxMaterials> Recipe;
+
+	static constexpr const Recipe* recipeForProduct(int item_id) {
+		return (item_id < 0 || item_id > Content::kMaxItemId || Content::recipe_by_product[item_id] < 0)
+		       ? nullptr : &Content::recipes[Content::recipe_by_product[item_id]];
+	}
+	static constexpr int batches(const Recipe& r, int qty) {
+		return (qty + (r.quantity_produced > 0 ? r.quantity_produced : 1) - 1) / (r.quantity_produced > 0 ? r.quantity_produced : 1);
+	}
+	// 对 qty 个产物所需的各材料调用 f(item_id, quantity)
+	template <class F>
+	static void forEachMaterial(const Recipe& r, int qty, F f) {
+		const int b = batches(r, qty);
+		for (int i = 0; i < Content::kMaxMaterials; ++i) {
+			if (r.materials[i].quantity > 0) f(r.materials[i].item_id, r.materials[i].quantity * b);
+		}
+	}
+	// 转回运行时 CraftingSystem，供调度器/模拟器等动态路径使用
+	static CraftingSystem toRuntime() {
+		CraftingSystem cs;
+		for (int i = 0; i < Content::kRecipeCount; ++i) {
+			const Recipe& sr = Content::recipes[i];
+			CraftingRecipe r(sr.crafting_id);
+			r.setProduct(sr.product_item_id, sr.quantity_produced, sr.production_time, sr.required_building_id);
+			for (int m = 0; m < Content::kMaxMaterials; ++m) {
+				if (sr.materials[m].quantity > 0) r.addMaterial(sr.materials[m].item_id, sr.materials[m].quantity);
+			}
+			cs.addRecipe(r);
+		}
+		return cs;
+	}
+};
+
+template <class Content>
+void TaskTree::buildFromContent(const std::map<int, Building>& buildings, double weight) {
+	clearGraph(); // 静态内容总是整树展开，忽略 setLazyExpansion
+	nodes_.reserve(Content::kDagSize);
+
+	// 与 buildFromDatabase 同序同形：先序行即节点顺序，父节点总在子节点之前
+	std::vector<int> node_of(Content::kDagSize, -1);
+	std::vector<std::vector<int> > kids(Content::kDagSize);
+	std::vector<double> weight_of(Content::kDagSize, weight);
+	for (int i = 0; i < Content::kDagSize; ++i) {
+		const StaticDagNode& row = Content::dag[i];
+		if (row.parent < 0) {
+			std::map<int, Building>::const_iterator b = buildings.find(row.building_id);
+			if (b == buildings.end()) continue;
+			TFNode build;
+			build.type = TaskType::Build;
+			build.item_id = row.item_id;
+			build.building_id = row.building_id;
+			build.demand = row.demand;
+			TFNodeMeta build_meta;
+			build_meta.unique_target = true;
+			build_meta.coord = std::make_pair(b->second.x, b->second.y);
+			weight_of[i] = isPinned(row.item_id) ? pinWeight(0) : weight * lookupWeight(row.item_id);
+			build.priority_weight = weight_of[i];
+			node_of[i] = addSite(build, build_meta);
+			continue;
+		}
+		if (node_of[row.parent] < 0) continue; // 所属建筑不在本局世界中
+		TFNode node;
+		node.type = static_cast<TaskType>(row.type);
+		node.item_id = row.item_id;
+		node.crafting_id = row.crafting_id;
+		node.demand = row.demand;
+		weight_of[i] = isPinned(row.item_id) ? pinWeight(row.depth) : weight_of[row.parent] * lookupWeight(row.item_id);
+		node.priority_weight = weight_of[i];
+		TFNodeMeta meta;
+		meta.depth = row.depth;
+		node_of[i] = addNode(node, meta);
+		kids[row.parent].push_back(node_of[i]);
+	}
+	for (int i = 0; i < Content::kDagSize; ++i) {
+		if (node_of[i] >= 0 && !kids[i].empty()) linkChildren(node_of[i], kids[i]);
+	}
+	compactTopology();
+	const CraftingSystem crafting = StaticCraftingSystem<Content>::toRuntime();
+	bom_.build(crafting); // 运行时订单沿用
+	initRanks(crafting, buildings);
+}
+
+#endif
@@ -2,6 +2,7 @@
 #define TASKFRAMEWORK_TASKTREE_HPP
 
 #include "WorldState.hpp"
+#include "BillOfMaterials.hpp"
 #include <map>
 #include <vector>
 #include <string>
@@ -10,6 +11,7 @@
 // Node definition (unified for scheduler/task tree)
 enum class TaskType { Gather, Craft, Build };
 
+// 热数据：就绪/缺口/分配每 tick 扫描的字段；拓扑以 CSR 形式存于 TaskTree
 struct TFNode {
 	int id;
 	TaskType type;
@@ -19,16 +21,34 @@ struct TFNode {
 	int allocated; // 已分配但未完成的数量（按批计）
 	int crafting_id;
 	int building_id;
+	double priority_weight;
+	int parent;      // 父节点（配方树中每个节点至多一个父节点），-1 为根
+	int child_begin; // 子节点在 TaskTree::child_idx_ 中的起点
+	int child_count;
+	int rank;        // HEFT 式向上秩（tick）：本节点耗时 + 后继（父节点 / 依赖本工作台的制作）的最大秩；已完成为 0
+	TFNode() : id(-1), type(TaskType::Gather), item_id(0), demand(0), produced(0), allocated(0),
+	           crafting_id(0), building_id(0), priority_weight(1.0), parent(-1), child_begin(0), child_count(0), rank(0) {}
+};
+
+// 冷数据：只在建造/交易时访问
+struct TFNodeMeta {
 	std::pair<int,int> coord;
 	bool unique_target;
-	double priority_weight;
 	int trade_count;
 	int last_trade_tick;
-	std::vector<int> parents;
-	std::vector<int> children;
-	TFNode() : id(-1), type(TaskType::Gather), item_id(0), demand(0), produced(0),
-	           allocated(0), priority_weight(1.0), trade_count(0), last_trade_tick(-1000000),
-	           crafting_id(0), building_id(0), coord(std::make_pair(0,0)), unique_target(false) {}
+	int depth; // 距所属 Build 节点的层数（置顶权重用）
+	int site;  // Build 节点的工地 id，其余为 -1
+	TFNodeMeta() : coord(std::make_pair(0,0)), unique_target(false), trade_count(0), last_trade_tick(-1000000), depth(0), site(-1) {}
+};
+
+// 连续的节点 id 区间（CSR 子节点列表）
+struct NodeRange {
+	const int* first;
+	const int* last;
+	const int* begin() const { return first; }
+	const int* end() const { return last; }
+	size_t size() const { return static_cast<size_t>(last - first); }
+	int operator[](size_t i) const { return first[i]; }
 };
 
 // Task event info
@@ -38,6 +58,8 @@ struct TaskInfo {
 	int item_id;
 	int quantity;
 	std::pair<int, int> coord;
+	int agent = -1; // 产生该事件的 agent（模拟器事件队列用），外部事件为 -1
+	int site = -1;  // type 1：工地 id（TaskTree::addBuildOrder 的返回值），-1 时按 target_id + coord 查找
 };
 
 // One-stop task manager: stores graph, demands, building coords, event handling
@@ -45,23 +67,53 @@ class TaskTree {
 public:
 	// Build from database data
 	void buildFromDatabase(const CraftingSystem& crafting, const std::map<int, Building>& buildings, double weight = 1.0);
+	// Build from compile-time content tables (see StaticContent.hpp / generated ShippedContent.hpp)
+	template <class Content>
+	void buildFromContent(const std::map<int, Building>& buildings, double weight = 1.0);
 
 	// Query
 	std::vector<int> ready(const WorldState& world) const;
 	TFNode& get(int id);
 	const TFNode& get(int id) const;
 	const std::vector<TFNode>& nodes() const;
+	NodeRange children(int id) const;
+	TFNodeMeta& meta(int id);
+	const TFNodeMeta& meta(int id) const;
 	void setPriorityWeights(const std::map<int,double>& weights);
 	void setPinnedItems(const std::set<int>& pins);
+	// 惰性展开（须在 buildFromDatabase 之前设置）：建树时只建 Build 节点；节点的直接材料在库存中不足时
+	// （即其子节点会成为缺口/分配候选时）才在 syncWithWorld 中生成子节点。建成后退役的子树被释放，
+	// 槽位供之后的展开复用，持有节点 id 的一方应丢弃 isFreed 的 id
+	void setLazyExpansion(bool enabled) { lazy_ = enabled; }
+	bool lazyExpansion() const { return lazy_; }
+	bool isFreed(int id) const { return id >= 0 && static_cast<size_t>(id) < freed_.size() && freed_[id]; }
+	size_t liveNodeCount() const { return nodes_.size() - free_.size(); }
+	size_t peakNodeCount() const { return peak_live_; }
+	size_t expansionCount() const { return expansions_; }
+
+	// 运行时建造订单：在 coord 新增一处 building_type 的工地，材料子树由该类建筑的模板实例化（惰性模式下待展开），
+	// priority 为订单的权重倍率（置顶规则照旧）。返回工地 id（不复用，可长期持有），无此建筑类型返回 -1。
+	// 新节点在下一次 ready/computeShortage 中可见，不重建整树
+	int addBuildOrder(int building_type, const std::pair<int,int>& coord, double priority, const WorldState& world);
+	// 撤销未完成的工地：释放其 Build 节点与子树（槽位复用，isFreed 为真）；已完成、已撤销或不存在返回 false
+	bool cancelBuildOrder(int site);
+	// 工地 id -> Build 节点，已撤销或不存在为 -1。建树时的每处建筑按节点顺序编号 0, 1, ...
+	int siteNode(int site) const { return site >= 0 && static_cast<size_t>(site) < site_node_.size() ? site_node_[site] : -1; }
+	size_t siteCount() const { return site_node_.size(); }
 
 	// Sync node produced values with world inventory/buildings (greedy fill)
+	// 首次全量对齐，之后只处理 WorldState 的 dirtyItems / dirtyBuildings
 	void syncWithWorld(WorldState& world);
 
 	// Requirements (building coords only)
 	void addBuildingRequire(int building_type, const std::pair<int,int>& coord);
 
 	// Event handling (external feedback)
+	// 类型 2 且 target_id 为本树节点时，同时记入该节点的 produced 并释放等量 allocated；
+	// 类型 1 将对应 Build 节点记为完成并释放其锁定
 	void applyEvent(const TaskInfo& info, WorldState& world);
+	// 一批事件：同物品的产出合并为一次入库，建成按顺序处理
+	void applyEvents(const std::vector<TaskInfo>& batch, WorldState& world);
 
 	// Queries
 	const std::vector<std::pair<int,int> >& getBuildingCoords(int building_type) const;
@@ -70,19 +122,69 @@ public:
 	bool isCompleted(int id, const WorldState& world) const;
 
 private:
-	int addNode(const TFNode& node);
-	void addEdge(int parent, int child);
-	int buildItemTask(int item_id, int qty, const CraftingSystem& crafting, double weight = 1.0, int depth = 0); // internal helper
+	int addNode(const TFNode& node, const TFNodeMeta& meta = TFNodeMeta());
+	void linkChildren(int parent, const std::vector<int>& kids); // 追加一段 CSR 子节点块
+	void compactTopology(); // 按节点顺序重排 child_idx_，使扫描顺序访问
+	void clearGraph();
+	int addItemNode(int item_id, int qty, const BillOfMaterials& bom, double weight, int depth); // 单个物品节点，不展开
+	// 惰性展开
+	std::vector<std::pair<int,int> > directMaterials(int id, const WorldState& world) const; // (item_id, 数量)
+	bool materialsCovered(int id, const WorldState& world) const;
+	void materialize(const WorldState& world);
+	void expand(int id, const WorldState& world);
+	void releaseSubtree(int id); // 从索引摘除并把槽位放回空闲表
+	void initSubtree(int root, const WorldState& world); // 新生成的子树：对齐库存、耗时、秩
+	int findBuildNode(const TaskInfo& info) const; // type 1 事件对应的未完成 Build 节点
+	int addSite(const TFNode& build, TFNodeMeta meta); // 建 Build 节点，登记工地 id 与坐标
+	int placeSite(const Building& b, const std::pair<int,int>& coord, double weight); // Build 节点 + 子树（惰性模式下待展开）
+
+	// 一类建筑的材料子树模板：先序行，首次用到时按 bom_ 展开一次，之后每处工地只按行复制节点（无配方查找）
+	struct TemplateRow {
+		TaskType type;
+		int item_id;
+		int crafting_id;
+		int demand;
+		int depth;
+		int parent; // 模板内下标，-1 为 Build 节点的直接子节点
+	};
+	const std::vector<TemplateRow>& siteTemplate(const Building& b);
+	void appendTemplateRows(std::vector<TemplateRow>& rows, int item_id, int qty, int depth, int parent) const;
+	void instantiate(const std::vector<TemplateRow>& rows, int build_id);
 	double lookupWeight(int item_id) const;
 	double pinWeight(int depth) const;
 	bool isPinned(int item_id) const;
+	void syncItemNode(TFNode& n, const WorldState& world);
+	void creditProduction(const TaskInfo& info); // 类型 2 事件记入来源节点
 	bool isCompleted(int id) const;
 	void retireSubtree(int id); // 将节点及其子节点需求清零（用于建造完成后避免重复需求）
+	// 向上秩：建树末尾按配方/建筑耗时初始化；节点完成或退役时只沿依赖它的前驱（子节点、所需工作台）增量重算
+	void initRanks(const CraftingSystem& crafting, const std::map<int, Building>& buildings);
+	void initNodeCost(int id, const CraftingSystem& crafting, const std::map<int, Building>& buildings); // rank_cost_ + 工作台登记
+	int computeRank(int id) const;
+	void refreshRank(int id);
 
 	std::vector<TFNode> nodes_;
+	std::vector<TFNodeMeta> meta_;
+	std::vector<int> child_idx_;
 	std::vector<std::vector<std::pair<int,int> > > building_cons_; // building_type indexed, coords list
 	std::map<int,double> priority_weights_;
 	std::set<int> pinned_items_;
+	std::map<int, std::vector<int> > item_nodes_;     // item_id -> 物品节点（Gather/Craft）
+	std::map<int, std::vector<int> > building_nodes_; // building_id -> Build 节点
+	std::vector<int> rank_cost_;                      // 节点耗时（tick）：采集 20/10 个、制作按批、建造按建筑
+	std::vector<int> workbench_of_;                   // Craft 节点 -> 所需工作台的 Build 节点，-1 无
+	std::map<int, std::vector<int> > workbench_users_; // 工作台 Build 节点 -> 依赖它的 Craft 节点
+	bool synced_ = false;
+	bool lazy_ = false;
+	BillOfMaterials bom_;           // 惰性模式展开用
+	std::vector<char> pending_;     // 节点 -> 子节点尚未生成
+	std::vector<char> freed_;       // 节点 -> 槽位已释放
+	std::vector<int> free_;
+	size_t dead_children_ = 0;      // child_idx_ 中已失效的条目数，过半时压缩
+	size_t expansions_ = 0;
+	size_t peak_live_ = 0;
+	std::map<int, std::vector<TemplateRow> > templates_; // building_id -> 模板（只读共享）
+	std::vector<int> site_node_;    // 工地 id -> Build 节点，-1 已撤销
 	static const double PIN_BASE;
 };
 
@@ -2,12 +2,18 @@
 #define TASKFRAMEWORK_WORLDSTATE_HPP
 
 #include "objects.hpp"
+#include <set>
+#include <queue>
+#include <functional>
+#include <random>
 
 class WorldState {
 public:
 	explicit WorldState(class DatabaseManager& db);
 
 	void CreateRandomWorld(int world_width, int world_height);
+	// 指定种子的布局（局部随机数发生器，可在多线程中各自调用）；种子 114514 与首次调用上面的版本相同
+	void CreateRandomWorld(int world_width, int world_height, unsigned seed);
 
 	// getters
 	std::map<int, Item>& getItems() { return items; }
@@ -27,13 +33,37 @@ public:
 	void addItem(int item_id, int qty);
 	void removeItem(int item_id, int qty);
 	bool hasEnoughItems(const std::vector<CraftingMaterial>& mats) const;
+	void completeBuilding(int building_id);
+
+	// 资源点惰性再生：每 period 个 tick 恢复 generation_rate，至多 capacity；0 关闭（默认）。
+	// 不逐 tick 扫描资源点，存量在查询/采集时按 tick 现算；tick 由模拟器每 tick 推进
+	void setResourceRegen(int period) { regen_period_ = period > 0 ? period : 0; }
+	int resourceRegen() const { return regen_period_; }
+	void setTick(int tick) { tick_ = tick; }
+	int tick() const { return tick_; }
+	int resourceAvailable(const ResourcePoint& rp) const { return rp.availableAt(tick_, regen_period_); }
+	int harvestResource(ResourcePoint& rp, int amount); // 结算后取走至多 amount，返回实取量
+	// 枯竭的资源点再生出第一批时依次取出其物品 id（采集者据此复查），没有到期的返回 false
+	bool popRefilled(int& item_id);
+
+	// change notifications：上次 clearDirty 以来数量变化的物品 / 新完成的建筑
+	const std::set<int>& dirtyItems() const { return dirty_items_; }
+	const std::set<int>& dirtyBuildings() const { return dirty_buildings_; }
+	void clearDirty();
 
 private:
+	void placeRandom(int world_width, int world_height, std::mt19937& rng);
+
 	class DatabaseManager& db_;
 	std::map<int, Item> items;
 	std::map<int, ResourcePoint> resource_points;
 	std::map<int, Building> buildings;
 	CraftingSystem crafting_system;
+	std::set<int> dirty_items_;
+	std::set<int> dirty_buildings_;
+	int regen_period_ = 0;
+	int tick_ = 0;
+	std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int> >, std::greater<std::pair<int, int> > > refills_; // (可采 tick, 资源点)
 };
 
 #endif
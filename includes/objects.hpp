@@ -24,8 +24,24 @@ struct ResourcePoint {
 	int resource_point_id = 0;
 	int resource_item_id = 0;
 	int x = 0, y = 0;
-	int generation_rate = 0;
-	int remaining_resource = 0;
+	int generation_rate = 0;    // 每个再生周期恢复的数量
+	int remaining_resource = 0; // last_tick 时的存量，当前存量见 availableAt
+	int capacity = 0;           // 再生上限
+	int last_tick = 0;          // remaining_resource 的结算 tick
+	// 惰性再生：每 period 个 tick 恢复 generation_rate，至多 capacity；period <= 0 不再生
+	int availableAt(int tick, int period) const {
+		if (period <= 0 || generation_rate <= 0 || remaining_resource >= capacity || tick <= last_tick) return remaining_resource;
+		long long steps = (tick - last_tick) / period;
+		long long amount = remaining_resource + steps * generation_rate;
+		return amount < capacity ? static_cast<int>(amount) : capacity;
+	}
+	// 把存量结算到 tick；未满时保留不足一个周期的余数
+	void settle(int tick, int period) {
+		int amount = availableAt(tick, period);
+		if (amount >= capacity || period <= 0 || generation_rate <= 0) last_tick = tick;
+		else last_tick += (amount - remaining_resource) / generation_rate * period;
+		remaining_resource = amount;
+	}
 	bool harvest(int amount) {
 		if (remaining_resource <= 0) return false;
 		int take = amount;
@@ -82,6 +98,53 @@ struct Building {
 	void completeConstruction() { isCompleted = true; }
 };
 
+// agent 随身货物：固定 kSlots 格（物品、数量、来源任务节点），不做堆分配；
+// 同物品同来源的货物合并到一格，总量上限 capacity 由调用方检查
+struct AgentInventory {
+	static const int kSlots = 4;
+	struct Slot {
+		int item_id = -1;
+		int quantity = 0;
+		int source = -1; // 产出它的任务节点，-1 未知
+	};
+	Slot slots[kSlots];
+	int capacity = 0;
+
+	int total() const {
+		int sum = 0;
+		for (int i = 0; i < kSlots; ++i) sum += slots[i].quantity;
+		return sum;
+	}
+	bool empty() const { return total() == 0; }
+	int freeSpace() const { return capacity > total() ? capacity - total() : 0; }
+	int carried(int item_id, int source) const {
+		for (int i = 0; i < kSlots; ++i) {
+			if (slots[i].quantity > 0 && slots[i].item_id == item_id && slots[i].source == source) return slots[i].quantity;
+		}
+		return 0;
+	}
+	// 放入货物，没有可合并的格也没有空格时返回 false
+	bool add(int item_id, int qty, int source) {
+		if (qty <= 0) return true;
+		int empty_slot = -1;
+		for (int i = 0; i < kSlots; ++i) {
+			if (slots[i].quantity > 0 && slots[i].item_id == item_id && slots[i].source == source) {
+				slots[i].quantity += qty;
+				return true;
+			}
+			if (slots[i].quantity == 0 && empty_slot < 0) empty_slot = i;
+		}
+		if (empty_slot < 0) return false;
+		slots[empty_slot].item_id = item_id;
+		slots[empty_slot].quantity = qty;
+		slots[empty_slot].source = source;
+		return true;
+	}
+	void clear() {
+		for (int i = 0; i < kSlots; ++i) slots[i] = Slot();
+	}
+};
+
 class Agent {
 public:
 	std::string name;
@@ -89,7 +152,7 @@ public:
 	int energyLevel = 0;
 	int x = 0, y = 0;
 	static const int speed = 180;
-	std::map<int,int> inventory;
+	AgentInventory inventory;
 	// Future use: pending tasks/bundle (ordered by priority)
 	std::vector<int> bundle;
 	Agent(const std::string& n, const std::string& r, int e, int px, int py, CraftingSystem* = nullptr)
@@ -0,0 +1,104 @@
+#ifndef TASKFRAMEWORK_TF_CAPI_H
+#define TASKFRAMEWORK_TF_CAPI_H
+
+/* TaskFramework 嵌入式 C 接口（libtfcapi）。
+ * 一个 tf_sim 句柄持有数据库、世界、任务树、调度器、工人与模拟器；同一句柄不可跨线程并发调用。
+ * 查询函数只写入调用方提供的缓冲区，不分配内存；返回实际条目数（超过 capacity 的部分截断）。 */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#define TF_API __declspec(dllexport)
+#else
+#define TF_API __attribute__((visibility("default")))
+#endif
+
+#define TF_CAPI_VERSION 6
+
+typedef struct tf_sim tf_sim;
+
+/* 事件类型，与 SimEvent::type 一致 */
+enum {
+	TF_EVENT_BUILT = 1,     /* target_id = building_id */
+	TF_EVENT_CRAFTED = 2,   /* target_id = item_id */
+	TF_EVENT_HARVESTED = 3  /* target_id = item_id */
+};
+
+/* 任务类型，与 TaskType 一致；TF_TASK_IDLE 表示空闲 */
+enum {
+	TF_TASK_IDLE = -1,
+	TF_TASK_GATHER = 0,
+	TF_TASK_CRAFT = 1,
+	TF_TASK_BUILD = 2
+};
+
+typedef struct {
+	int tick;
+	int type;
+	int agent;
+	int target_id;
+	int quantity;
+} tf_event;
+
+typedef struct {
+	int x;
+	int y;
+} tf_position;
+
+typedef struct {
+	int node_id;   /* 任务节点 id，空闲为 -1 */
+	int type;      /* TF_TASK_* */
+	int target_id; /* Gather/Craft 为 item_id，Build 为 building_id */
+} tf_task;
+
+typedef void (*tf_event_callback)(const tf_event* event, void* user_data);
+
+TF_API int tf_capi_version(void);
+
+/* 从 SQLite 内容库创建世界（随机布局，固定种子），world_width/height <= 0 时取 2000。失败返回 NULL */
+TF_API tf_sim* tf_create(const char* db_path, int world_width, int world_height);
+TF_API void tf_destroy(tf_sim* sim);
+
+/* 追加工人，返回其下标；可在两次 tf_step 之间调用 */
+TF_API int tf_add_agent(tf_sim* sim, int x, int y);
+
+/* 日志文件（NULL 或空串关闭，默认关闭）；须在第一次 tf_step 之前设置 */
+TF_API void tf_set_log(tf_sim* sim, const char* path);
+TF_API void tf_set_event_callback(tf_sim* sim, tf_event_callback cb, void* user_data);
+/* 资源点再生：每 period 个 tick 恢复其 generation_rate，至多初始存量；period <= 0 关闭（默认） */
+TF_API void tf_set_resource_regen(tf_sim* sim, int period);
+/* 资源点可同时采集的人数（至少 1，默认 1）；resource_point_id < 0 设置全部资源点。返回 1 成功，0 无此资源点 */
+TF_API int tf_set_resource_slots(tf_sim* sim, int resource_point_id, int slots);
+/* 随身搬运：每人至多 capacity 件，产出送到最近的仓库或消费地才入库；0 关闭（默认，产出直接入库） */
+TF_API void tf_set_carry_capacity(tf_sim* sim, int capacity);
+/* 竞价限时（微秒，自重规划开始计）：到期返回已有分配，余下任务下一次重规划继续；<= 0 关闭（默认） */
+TF_API void tf_set_assign_budget(tf_sim* sim, long long micros);
+
+/* 运行时建造订单：在 (x, y) 新增一处 building_type 的工地，priority 为权重倍率（<= 0 取 1）；
+ * 返回订单 id，无此建筑类型返回 -1。可在两次 tf_step 之间调用，下一次重规划即被分配 */
+TF_API int tf_add_build_order(tf_sim* sim, int building_type, int x, int y, double priority);
+/* 撤销未完成的订单：1 成功，0 订单不存在、已撤销或已完成 */
+TF_API int tf_cancel_build_order(tf_sim* sim, int order);
+/* 1 已建成，0 未建成，-1 无此订单或已撤销。建树时的每处建筑也是订单，按 building_id 升序编号 0, 1, ... */
+TF_API int tf_order_completed(const tf_sim* sim, int order);
+
+/* 推进 ticks 个 tick（20 tick/s），返回推进后的当前 tick；失败返回 -1 */
+TF_API int tf_step(tf_sim* sim, int ticks);
+TF_API int tf_current_tick(const tf_sim* sim);
+
+TF_API int tf_agent_count(const tf_sim* sim);
+TF_API int tf_get_agent_positions(const tf_sim* sim, tf_position* out, int capacity);
+TF_API int tf_get_agent_tasks(const tf_sim* sim, tf_task* out, int capacity);
+/* 1 已建成，0 未建成，-1 无此建筑 */
+TF_API int tf_building_completed(const tf_sim* sim, int building_id);
+TF_API int tf_item_quantity(const tf_sim* sim, int item_id);
+/* 资源点当前存量（含再生），-1 无此资源点 */
+TF_API int tf_resource_remaining(const tf_sim* sim, int resource_point_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,146 @@
+#include "../includes/AgentBehavior.hpp"
+#include <algorithm>
+#include <new>
+
+namespace {
+const std::size_t kHeader = 16;   // 块头：所属池 + 级别，保持帧 16 字节对齐
+const std::size_t kGranule = 64;
+const std::size_t kBlocksPerSlab = 32;
+
+struct BlockHeader {
+	FramePool* pool;
+	std::size_t cls;
+};
+static_assert(sizeof(BlockHeader) <= kHeader, "frame header too large");
+}
+
+FramePool::~FramePool() {
+	for (std::size_t i = 0; i < slabs_.size(); ++i) ::operator delete(slabs_[i]);
+}
+
+void* FramePool::allocateFrom(FramePool* pool, std::size_t n) {
+	if (pool) return pool->allocate(n);
+	void* block = ::operator new(n + kHeader);
+	BlockHeader* h = static_cast<BlockHeader*>(block);
+	h->pool = nullptr;
+	h->cls = 0;
+	return static_cast<char*>(block) + kHeader;
+}
+
+void FramePool::release(void* frame) {
+	if (!frame) return;
+	void* block = static_cast<char*>(frame) - kHeader;
+	BlockHeader* h = static_cast<BlockHeader*>(block);
+	if (h->pool) h->pool->deallocate(block, h->cls);
+	else ::operator delete(block);
+}
+
+void* FramePool::allocate(std::size_t n) {
+	std::size_t cls = (n + kHeader + kGranule - 1) / kGranule;
+	if (free_.size() <= cls) free_.resize(cls + 1);
+	++allocations_;
+	if (free_[cls].empty()) {
+		std::size_t block_size = cls * kGranule;
+		char* slab = static_cast<char*>(::operator new(block_size * kBlocksPerSlab));
+		slabs_.push_back(slab);
+		for (std::size_t i = kBlocksPerSlab; i > 0; --i) free_[cls].push_back(slab + (i - 1) * block_size);
+	}
+	void* block = free_[cls].back();
+	free_[cls].pop_back();
+	BlockHeader* h = static_cast<BlockHeader*>(block);
+	h->pool = this;
+	h->cls = cls;
+	return static_cast<char*>(block) + kHeader;
+}
+
+void FramePool::deallocate(void* block, std::size_t cls) {
+	free_[cls].push_back(block);
+}
+
+void BehaviorScheduler::start(std::size_t aid, Behavior b, int tick) {
+	resize(aid + 1);
+	Slot& s = slots_[aid];
+	s.behavior = std::move(b);
+	s.wait_id++;
+	s.waiting = true;
+	s.phase = Phase::Move;
+	stats_.started++;
+	Wake w = {aid, s.wait_id, Phase::Move, WakeReason::Timer};
+	schedule(w, tick);
+}
+
+void BehaviorScheduler::stop(std::size_t aid) {
+	if (aid >= slots_.size()) return;
+	Slot& s = slots_[aid];
+	s.wait_id++; // 作废尚未触发的计时与事件登记
+	s.waiting = false;
+	s.behavior.reset();
+}
+
+void BehaviorScheduler::park(std::size_t aid, int tick, Phase phase, EventKey a, EventKey b) {
+	Slot& s = slots_[aid];
+	s.wait_id++;
+	s.waiting = true;
+	s.phase = phase;
+	if (tick >= 0) {
+		Wake w = {aid, s.wait_id, phase, WakeReason::Timer};
+		schedule(w, tick);
+	}
+	if (a.kind != EventKind::None) waiters_[a].push_back(std::make_pair(aid, s.wait_id));
+	if (b.kind != EventKind::None) waiters_[b].push_back(std::make_pair(aid, s.wait_id));
+}
+
+void BehaviorScheduler::schedule(const Wake& w, int tick) {
+	if (phase_ >= 0 && tick <= now_) {
+		// runTick 内：本 tick 尚未处理到的阶段直接入队，否则顺延到下一 tick
+		if (tick == now_ && static_cast<int>(w.phase) > phase_) {
+			queue_[static_cast<int>(w.phase)].push_back(w);
+			return;
+		}
+		tick = now_ + 1;
+	} else if (tick <= now_) {
+		tick = now_ + 1;
+	}
+	timers_[tick].push_back(w);
+}
+
+void BehaviorScheduler::signal(EventKey key, int tick) {
+	std::map<EventKey, std::vector<std::pair<std::size_t, unsigned> > >::iterator it = waiters_.find(key);
+	if (it == waiters_.end()) return;
+	std::vector<std::pair<std::size_t, unsigned> > list;
+	list.swap(it->second);
+	waiters_.erase(it);
+	for (std::size_t i = 0; i < list.size(); ++i) {
+		const Slot& s = slots_[list[i].first];
+		if (!s.waiting || s.wait_id != list[i].second) continue; // 已被计时唤醒或已停止
+		Wake w = {list[i].first, list[i].second, s.phase, WakeReason::Event};
+		schedule(w, tick);
+	}
+}
+
+void BehaviorScheduler::runTick(int t) {
+	now_ = t;
+	queue_.assign(4, std::vector<Wake>());
+	std::map<int, std::vector<Wake> >::iterator due = timers_.find(t);
+	if (due != timers_.end()) {
+		for (std::size_t i = 0; i < due->second.size(); ++i) queue_[static_cast<int>(due->second[i].phase)].push_back(due->second[i]);
+		timers_.erase(due);
+	}
+	for (int p = 0; p < 4; ++p) {
+		phase_ = p;
+		std::vector<Wake>& q = queue_[p];
+		// 同阶段按 agent 编号恢复；恢复过程中只会向更晚的阶段追加
+		std::stable_sort(q.begin(), q.end(), [](const Wake& a, const Wake& b) { return a.aid < b.aid; });
+		for (std::size_t i = 0; i < q.size(); ++i) {
+			Slot& s = slots_[q[i].aid];
+			if (!s.waiting || s.wait_id != q[i].wait_id || s.behavior.done()) continue;
+			s.waiting = false;
+			s.reason = q[i].reason;
+			if (q[i].reason == WakeReason::Timer) stats_.timer_wakes++;
+			else stats_.event_wakes++;
+			stats_.resumes++;
+			s.behavior.resume();
+		}
+	}
+	phase_ = -1;
+}
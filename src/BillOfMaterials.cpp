@@ -0,0 +1,114 @@
+#include "../includes/BillOfMaterials.hpp"
+#include <algorithm>
+
+namespace {
+int batchesFor(const CraftingRecipe& r, int qty) {
+	int out = r.quantity_produced > 0 ? r.quantity_produced : 1;
+	return (qty + out - 1) / out;
+}
+}
+
+void BillOfMaterials::build(const CraftingSystem& crafting) {
+	recipe_of_.clear();
+	level_.clear();
+	per_batch_.clear();
+	order_.clear();
+
+	// 同一产物有多条配方时取 crafting_id 最小者（map 有序，先到先得）
+	const std::map<int, CraftingRecipe>& all = crafting.getAllRecipes();
+	for (std::map<int, CraftingRecipe>::const_iterator it = all.begin(); it != all.end(); ++it) {
+		if (recipe_of_.find(it->second.product_item_id) == recipe_of_.end()) {
+			recipe_of_[it->second.product_item_id] = it->second;
+		}
+	}
+
+	// 层级：反复松弛直到稳定（配方图无环；有环时以配方数为上限截断）
+	for (std::map<int, CraftingRecipe>::const_iterator it = recipe_of_.begin(); it != recipe_of_.end(); ++it) {
+		level_[it->first] = 1;
+		for (size_t i = 0; i < it->second.materials.size(); ++i) level_.insert(std::make_pair(it->second.materials[i].item_id, 0));
+	}
+	const int cap = static_cast<int>(recipe_of_.size()) + 1;
+	for (bool changed = true; changed; ) {
+		changed = false;
+		for (std::map<int, CraftingRecipe>::const_iterator it = recipe_of_.begin(); it != recipe_of_.end(); ++it) {
+			int lv = 1;
+			for (size_t i = 0; i < it->second.materials.size(); ++i) {
+				lv = std::max(lv, level(it->second.materials[i].item_id) + 1);
+			}
+			lv = std::min(lv, cap);
+			if (lv != level_[it->first]) {
+				level_[it->first] = lv;
+				changed = true;
+			}
+		}
+	}
+	for (std::map<int, int>::const_iterator it = level_.begin(); it != level_.end(); ++it) order_.push_back(it->first);
+	std::stable_sort(order_.begin(), order_.end(), [this](int a, int b) { return level(a) > level(b); });
+
+	for (std::map<int, CraftingRecipe>::const_iterator it = recipe_of_.begin(); it != recipe_of_.end(); ++it) {
+		explode(it->first, it->second.quantity_produced > 0 ? it->second.quantity_produced : 1, per_batch_[it->first]);
+	}
+}
+
+const CraftingRecipe* BillOfMaterials::recipeFor(int item_id) const {
+	std::map<int, CraftingRecipe>::const_iterator it = recipe_of_.find(item_id);
+	return it == recipe_of_.end() ? nullptr : &it->second;
+}
+
+int BillOfMaterials::level(int item_id) const {
+	std::map<int, int>::const_iterator it = level_.find(item_id);
+	return it == level_.end() ? 0 : it->second;
+}
+
+const std::map<int, int>& BillOfMaterials::perBatch(int item_id) const {
+	static const std::map<int, int> empty;
+	std::map<int, std::map<int, int> >::const_iterator it = per_batch_.find(item_id);
+	return it == per_batch_.end() ? empty : it->second;
+}
+
+void BillOfMaterials::explode(int item_id, int qty, std::map<int, int>& out) const {
+	if (qty <= 0 || !recipeFor(item_id)) return;
+	// 同一中间品的需求先按层级汇总再取整批次（比逐节点取整更紧）
+	std::map<int, int> pending;
+	pending[item_id] = qty;
+	for (size_t oi = 0; oi < order_.size(); ++oi) {
+		std::map<int, int>::iterator p = pending.find(order_[oi]);
+		if (p == pending.end()) continue;
+		const CraftingRecipe* r = recipeFor(p->first);
+		if (r) {
+			int b = batchesFor(*r, p->second);
+			for (size_t i = 0; i < r->materials.size(); ++i) {
+				int q = r->materials[i].quantity_required * b;
+				pending[r->materials[i].item_id] += q;
+				out[r->materials[i].item_id] += q;
+			}
+		}
+	}
+}
+
+std::map<int, int> BillOfMaterials::netRequirements(std::map<int, int> gross, const std::map<int, int>& on_hand) const {
+	std::map<int, int> net;
+	// 不在配方图里的物品（无配方也不作材料）直接按毛需求扣减
+	for (std::map<int, int>::const_iterator it = gross.begin(); it != gross.end(); ++it) {
+		if (level_.find(it->first) != level_.end()) continue;
+		std::map<int, int>::const_iterator h = on_hand.find(it->first);
+		int miss = it->second - (h != on_hand.end() ? h->second : 0);
+		if (miss > 0) net[it->first] = miss;
+	}
+	for (size_t oi = 0; oi < order_.size(); ++oi) {
+		int item = order_[oi];
+		std::map<int, int>::const_iterator g = gross.find(item);
+		if (g == gross.end()) continue;
+		std::map<int, int>::const_iterator h = on_hand.find(item);
+		int miss = g->second - (h != on_hand.end() ? h->second : 0);
+		if (miss <= 0) continue;
+		net[item] = miss;
+		const CraftingRecipe* r = recipeFor(item);
+		if (!r) continue;
+		int b = batchesFor(*r, miss);
+		for (size_t i = 0; i < r->materials.size(); ++i) {
+			gross[r->materials[i].item_id] += r->materials[i].quantity_required * b;
+		}
+	}
+	return net;
+}
@@ -0,0 +1,254 @@
+#include "../includes/ConsensusAuction.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace {
+
+struct Entry {
+	int task;
+	double score;
+	int agent;
+};
+
+struct Message {
+	int deliver_round;
+	std::vector<Entry> entries;
+};
+
+struct Inbox {
+	std::mutex mu;
+	std::vector<Message> msgs;
+};
+
+// (s1, a1) 是否优于 (s2, a2)：出价高者胜，同分 agent 编号小者胜；a < 0 表示无人出价
+bool better(double s1, int a1, double s2, int a2) {
+	if (a1 < 0) return false;
+	if (a2 < 0) return true;
+	if (s1 != s2) return s1 > s2;
+	return a1 < a2;
+}
+
+// 轮次屏障：最后到达的线程执行 on_complete，其返回值（是否结束）广播给本轮所有线程
+class RoundBarrier {
+public:
+	RoundBarrier(int n, const std::function<bool()>& on_complete) : n_(n), on_complete_(on_complete) {}
+	bool arriveAndWait() {
+		std::unique_lock<std::mutex> lock(mu_);
+		int gen = generation_;
+		if (++arrived_ == n_) {
+			arrived_ = 0;
+			done_ = on_complete_();
+			++generation_;
+			cv_.notify_all();
+			return done_;
+		}
+		cv_.wait(lock, [&]() { return gen != generation_; });
+		return done_;
+	}
+
+private:
+	std::mutex mu_;
+	std::condition_variable cv_;
+	int n_;
+	int arrived_ = 0;
+	int generation_ = 0;
+	bool done_ = false;
+	std::function<bool()> on_complete_;
+};
+
+std::vector<std::vector<int> > neighbours(int groups, ConsensusTopology topo) {
+	std::vector<std::vector<int> > nb(groups);
+	for (int g = 0; g < groups; ++g) {
+		for (int h = 0; h < groups; ++h) {
+			if (h == g) continue;
+			bool link = false;
+			switch (topo) {
+			case ConsensusTopology::Full: link = true; break;
+			case ConsensusTopology::Ring: link = (h == (g + 1) % groups) || (g == (h + 1) % groups); break;
+			case ConsensusTopology::Line: link = std::abs(g - h) == 1; break;
+			case ConsensusTopology::Star: link = (g == 0) || (h == 0); break;
+			}
+			if (link) nb[g].push_back(h);
+		}
+	}
+	return nb;
+}
+
+struct Group {
+	std::vector<int> agents;                 // 本组 agent（全局下标）
+	std::vector<std::vector<int> > bundles;  // 与 agents 对应
+	std::vector<double> win_score;           // task -> 本组所知最高出价
+	std::vector<int> win_agent;              // task -> 本组所知赢家，-1 无
+	bool changed = false;
+	long long sent = 0;
+	long long entries = 0;
+	long long lost = 0;
+	std::mt19937 rng;
+};
+
+} // namespace
+
+bool parseConsensusTopology(const std::string& name, ConsensusTopology& out) {
+	if (name == "full") out = ConsensusTopology::Full;
+	else if (name == "ring") out = ConsensusTopology::Ring;
+	else if (name == "line") out = ConsensusTopology::Line;
+	else if (name == "star") out = ConsensusTopology::Star;
+	else return false;
+	return true;
+}
+
+std::vector<std::vector<int> > ConsensusAuction::solve(const std::vector<std::vector<double> >& bids, ConsensusStats& stats) const {
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	const int n_agents = static_cast<int>(bids.size());
+	const int n_tasks = n_agents > 0 ? static_cast<int>(bids[0].size()) : 0;
+	const int groups = std::max(1, config_.groups);
+	const int limit = std::max(1, config_.bundle_limit);
+
+	std::vector<Group> gs(groups);
+	std::vector<int> group_of(n_agents, 0), local_of(n_agents, 0);
+	for (int g = 0; g < groups; ++g) {
+		int lo = static_cast<int>(static_cast<long long>(n_agents) * g / groups);
+		int hi = static_cast<int>(static_cast<long long>(n_agents) * (g + 1) / groups);
+		for (int a = lo; a < hi; ++a) {
+			group_of[a] = g;
+			local_of[a] = static_cast<int>(gs[g].agents.size());
+			gs[g].agents.push_back(a);
+		}
+		gs[g].bundles.assign(gs[g].agents.size(), std::vector<int>());
+		gs[g].win_score.assign(n_tasks, 0.0);
+		gs[g].win_agent.assign(n_tasks, -1);
+		gs[g].rng.seed(config_.seed + 7919u * static_cast<unsigned>(g) + 104729u * static_cast<unsigned>(stats.runs));
+	}
+	std::vector<std::vector<int> > nb = neighbours(groups, config_.topology);
+	std::vector<Inbox> inboxes(groups);
+
+	int round = 0;
+	bool converged = false;
+	RoundBarrier barrier(groups, [&]() {
+		bool same = true;
+		for (int g = 0; g < groups && same; ++g) {
+			if (gs[g].changed) same = false;
+			else if (g > 0 && (gs[g].win_agent != gs[0].win_agent || gs[g].win_score != gs[0].win_score)) same = false;
+		}
+		++round;
+		converged = same;
+		return same || round >= config_.max_rounds;
+	});
+
+	auto dropFromBundle = [&](Group& grp, int agent, int task) {
+		std::vector<int>& b = grp.bundles[local_of[agent]];
+		b.erase(std::remove(b.begin(), b.end(), task), b.end());
+	};
+
+	auto runGroup = [&](int g) {
+		Group& grp = gs[g];
+		std::uniform_real_distribution<double> coin(0.0, 1.0);
+		std::uniform_int_distribution<int> delay(0, std::max(0, config_.max_delay));
+		for (int r = 0; ; ++r) {
+			grp.changed = false;
+			// 1) 收消息，最大值合并；本组 agent 被超价的任务移出其 bundle
+			std::vector<Message> ready;
+			{
+				std::lock_guard<std::mutex> lock(inboxes[g].mu);
+				std::vector<Message> later;
+				for (size_t i = 0; i < inboxes[g].msgs.size(); ++i) {
+					if (inboxes[g].msgs[i].deliver_round <= r) ready.push_back(inboxes[g].msgs[i]);
+					else later.push_back(inboxes[g].msgs[i]);
+				}
+				inboxes[g].msgs.swap(later);
+			}
+			for (size_t m = 0; m < ready.size(); ++m) {
+				for (size_t e = 0; e < ready[m].entries.size(); ++e) {
+					const Entry& en = ready[m].entries[e];
+					if (!better(en.score, en.agent, grp.win_score[en.task], grp.win_agent[en.task])) continue;
+					int prev = grp.win_agent[en.task];
+					if (prev >= 0 && group_of[prev] == g) dropFromBundle(grp, prev, en.task);
+					grp.win_score[en.task] = en.score;
+					grp.win_agent[en.task] = en.agent;
+					grp.changed = true;
+				}
+			}
+			// 2) 组内 agent 依次补满 bundle：只加自己出价能赢的任务，取出价最高者
+			for (size_t li = 0; li < grp.agents.size(); ++li) {
+				int a = grp.agents[li];
+				while (static_cast<int>(grp.bundles[li].size()) < limit) {
+					int best = -1;
+					for (int t = 0; t < n_tasks; ++t) {
+						double b = bids[a][t];
+						if (std::isnan(b) || grp.win_agent[t] == a) continue;
+						if (!better(b, a, grp.win_score[t], grp.win_agent[t])) continue;
+						if (best < 0 || b > bids[a][best]) best = t;
+					}
+					if (best < 0) break;
+					int prev = grp.win_agent[best];
+					if (prev >= 0 && group_of[prev] == g) dropFromBundle(grp, prev, best);
+					grp.win_score[best] = bids[a][best];
+					grp.win_agent[best] = a;
+					grp.bundles[li].push_back(best);
+					grp.changed = true;
+				}
+			}
+			// 3) 把赢家表发给邻居（每条消息独立决定丢失与延迟）
+			std::vector<Entry> entries;
+			for (int t = 0; t < n_tasks; ++t) {
+				if (grp.win_agent[t] >= 0) entries.push_back(Entry{t, grp.win_score[t], grp.win_agent[t]});
+			}
+			if (!entries.empty()) {
+				for (size_t k = 0; k < nb[g].size(); ++k) {
+					if (config_.loss > 0.0 && coin(grp.rng) < config_.loss) { grp.lost++; continue; }
+					Message msg;
+					msg.deliver_round = r + 1 + (config_.max_delay > 0 ? delay(grp.rng) : 0);
+					msg.entries = entries;
+					std::lock_guard<std::mutex> lock(inboxes[nb[g][k]].mu);
+					inboxes[nb[g][k]].msgs.push_back(msg);
+					grp.sent++;
+					grp.entries += static_cast<long long>(entries.size());
+				}
+			}
+			if (barrier.arriveAndWait()) break;
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (int g = 1; g < groups; ++g) threads.push_back(std::thread(runGroup, g));
+	runGroup(0);
+	for (size_t i = 0; i < threads.size(); ++i) threads[i].join();
+
+	// 收尾：未一致时以各组所知的最高出价为准，去掉 agent 实际并未赢得的任务，保证每个任务至多一人
+	std::vector<int> final_agent(n_tasks, -1);
+	std::vector<double> final_score(n_tasks, 0.0);
+	for (int g = 0; g < groups; ++g) {
+		for (int t = 0; t < n_tasks; ++t) {
+			if (better(gs[g].win_score[t], gs[g].win_agent[t], final_score[t], final_agent[t])) {
+				final_score[t] = gs[g].win_score[t];
+				final_agent[t] = gs[g].win_agent[t];
+			}
+		}
+	}
+	std::vector<std::vector<int> > out(n_agents);
+	for (int a = 0; a < n_agents; ++a) {
+		const std::vector<int>& b = gs[group_of[a]].bundles[local_of[a]];
+		for (size_t k = 0; k < b.size(); ++k) {
+			if (final_agent[b[k]] == a) out[a].push_back(b[k]);
+		}
+	}
+
+	stats.runs++;
+	if (!converged) stats.unconverged++;
+	stats.rounds_last = round;
+	stats.rounds_max = std::max(stats.rounds_max, round);
+	stats.rounds_total += round;
+	for (int g = 0; g < groups; ++g) {
+		stats.messages += gs[g].sent;
+		stats.entries += gs[g].entries;
+		stats.lost += gs[g].lost;
+	}
+	stats.micros_total += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+	return out;
+}
@@ -104,6 +104,7 @@ bool DatabaseManager::initialize_all_data() {
 			rp.resource_item_id = item_id;
 			rp.generation_rate = sqlite3_column_int(stmt, 2);
 			rp.remaining_resource = 1000;
+			rp.capacity = rp.remaining_resource;
 			resource_point_database[rp.resource_point_id] = rp;
 		}
 		sqlite3_finalize(stmt);
@@ -0,0 +1,189 @@
+#include "../includes/Forecaster.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+namespace {
+const int kHarvestTicks = 20; // 与 Simulator 一致：每 20 tick 采一次
+const int kHarvestBatch = 10; // 每次至多 10 个
+const int kTicksPerSecond = 20;
+
+int ceilDiv(long long a, long long b) {
+	return static_cast<int>((a + b - 1) / b);
+}
+
+int travelTicks(const std::pair<int,int>& a, const std::pair<int,int>& b) {
+	int d = std::abs(a.first - b.first) + std::abs(a.second - b.second);
+	return ceilDiv(d, Agent::speed / kTicksPerSecond);
+}
+}
+
+Forecaster::Forecaster(const WorldState& world, const TaskTree& tree) : world_(world), tree_(tree) {
+	const std::vector<TFNode>& nodes = tree_.nodes();
+	const size_t n = nodes.size();
+	units_.assign(n, 0);
+	unit_ticks_.assign(n, 0);
+	travel_.assign(n, 0);
+	workbench_.assign(n, -1);
+	unreachable_.assign(n, 0);
+
+	for (std::map<int, ResourcePoint>::const_iterator it = world_.getResourcePoints().begin(); it != world_.getResourcePoints().end(); ++it) {
+		if (world_.resourceAvailable(it->second) > 0) rp_count_[it->second.resource_item_id]++;
+	}
+	for (size_t i = 0; i < n; ++i) {
+		if (nodes[i].type == TaskType::Build && !build_node_.count(nodes[i].building_id)) build_node_[nodes[i].building_id] = static_cast<int>(i);
+	}
+
+	// 工作地点自上而下传递（父节点 id 总小于子节点）：Build 在工地，Craft 在工作台（无则随父），Gather 在离父最近的资源点
+	std::vector<std::pair<int,int> > loc(n, std::make_pair(0, 0));
+	for (size_t i = 0; i < n; ++i) {
+		const TFNode& node = nodes[i];
+		int rem = tree_.remainingNeedRaw(node, world_);
+		std::pair<int,int> anchor = node.parent >= 0 ? loc[node.parent] : tree_.meta(node.id).coord;
+		if (node.type == TaskType::Build) {
+			loc[i] = tree_.meta(node.id).coord;
+			const Building* b = world_.getBuilding(node.building_id);
+			if (rem > 0 && b) {
+				units_[i] = 1;
+				unit_ticks_[i] = std::max(1, b->construction_time * kTicksPerSecond);
+			}
+		} else if (node.type == TaskType::Craft) {
+			loc[i] = anchor;
+			const CraftingRecipe* r = world_.getCraftingSystem().getRecipe(node.crafting_id);
+			if (r && r->required_building_id > 0) {
+				const Building* wb = world_.getBuilding(r->required_building_id);
+				if (wb) loc[i] = std::make_pair(wb->x, wb->y);
+				std::map<int, int>::const_iterator bn = build_node_.find(r->required_building_id);
+				if (wb && !wb->isCompleted && bn != build_node_.end()) workbench_[i] = bn->second;
+			}
+			if (rem > 0 && r) {
+				int out = r->quantity_produced > 0 ? r->quantity_produced : 1;
+				units_[i] = ceilDiv(rem, out);
+				unit_ticks_[i] = std::max(1, r->production_time * kTicksPerSecond);
+				travel_[i] = travelTicks(loc[i], anchor);
+			}
+		} else {
+			loc[i] = anchor;
+			int best = -1;
+			for (std::map<int, ResourcePoint>::const_iterator it = world_.getResourcePoints().begin(); it != world_.getResourcePoints().end(); ++it) {
+				const ResourcePoint& rp = it->second;
+				if (rp.resource_item_id != node.item_id || world_.resourceAvailable(rp) <= 0) continue;
+				int d = std::abs(rp.x - anchor.first) + std::abs(rp.y - anchor.second);
+				if (best < 0 || d < best) { best = d; loc[i] = std::make_pair(rp.x, rp.y); }
+			}
+			if (rem > 0) {
+				if (best < 0) unreachable_[i] = 1;
+				units_[i] = ceilDiv(rem, kHarvestBatch);
+				unit_ticks_[i] = kHarvestTicks;
+				travel_[i] = travelTicks(loc[i], anchor);
+			}
+		}
+	}
+
+	// 子树中有采不到的原料则整条链无法完成
+	for (size_t i = n; i-- > 0; ) {
+		if (tree_.remainingNeedRaw(nodes[i], world_) <= 0) continue;
+		NodeRange kids = tree_.children(static_cast<int>(i));
+		for (const int* c = kids.begin(); c != kids.end(); ++c) {
+			if (unreachable_[*c]) unreachable_[i] = 1;
+		}
+	}
+	for (size_t i = 0; i < n; ++i) {
+		if (workbench_[i] >= 0 && unreachable_[workbench_[i]]) unreachable_[i] = 1;
+	}
+}
+
+int Forecaster::lanes(int id, int workers) const {
+	const TFNode& node = tree_.get(id);
+	if (node.type == TaskType::Build) return 1;
+	if (node.type == TaskType::Craft) return workers;
+	// 同一资源点同时只容一人
+	std::map<int, int>::const_iterator rc = rp_count_.find(node.item_id);
+	return std::max(1, std::min(workers, rc != rp_count_.end() ? rc->second : 1));
+}
+
+// 最早完工：并行后的自身耗时 + max(子节点, 所需工作台)；finish 中 -1 未算、-2 计算中（工作台成环时按 0 处理）
+int Forecaster::finishOf(int id, int workers, std::vector<int>& finish) const {
+	if (finish[id] >= 0) return finish[id];
+	if (finish[id] == -2) return 0;
+	finish[id] = -2;
+	int start = 0;
+	if (units_[id] > 0) {
+		NodeRange kids = tree_.children(id);
+		for (const int* c = kids.begin(); c != kids.end(); ++c) start = std::max(start, finishOf(*c, workers, finish));
+		if (workbench_[id] >= 0) start = std::max(start, finishOf(workbench_[id], workers, finish));
+		start += ceilDiv(units_[id], lanes(id, workers)) * unit_ticks_[id] + travel_[id];
+	}
+	finish[id] = start;
+	return start;
+}
+
+void Forecaster::collect(int id, std::vector<char>& seen, std::vector<int>& out) const {
+	if (seen[id]) return;
+	seen[id] = 1;
+	if (units_[id] == 0) return; // 已满足的子树不再需要
+	out.push_back(id);
+	NodeRange kids = tree_.children(id);
+	for (const int* c = kids.begin(); c != kids.end(); ++c) collect(*c, seen, out);
+	if (workbench_[id] >= 0) collect(workbench_[id], seen, out);
+}
+
+BuildForecast Forecaster::estimate(const std::vector<int>& roots, int workers) const {
+	BuildForecast f;
+	if (workers < 1) workers = 1;
+	std::vector<char> seen(units_.size(), 0);
+	std::vector<int> finish(units_.size(), -1);
+	std::vector<int> set;
+	bool blocked = false;
+	for (size_t i = 0; i < roots.size(); ++i) {
+		f.critical_path = std::max(f.critical_path, finishOf(roots[i], workers, finish));
+		if (unreachable_[roots[i]]) blocked = true;
+		collect(roots[i], seen, set);
+	}
+	std::map<int, long long> harvest_by_item;
+	for (size_t i = 0; i < set.size(); ++i) {
+		const TFNode& node = tree_.get(set[i]);
+		f.work += nodeDuration(set[i]);
+		if (node.type == TaskType::Gather) harvest_by_item[node.item_id] += static_cast<long long>(units_[set[i]]) * unit_ticks_[set[i]];
+	}
+	if (blocked) {
+		f.lower_bound = f.upper_bound = -1;
+		return f;
+	}
+	// 同一资源点同时只容一人：某原料的采集最多并行 min(N, 资源点数) 份
+	int rp_bound = 0;
+	for (std::map<int, long long>::const_iterator it = harvest_by_item.begin(); it != harvest_by_item.end(); ++it) {
+		std::map<int, int>::const_iterator rc = rp_count_.find(it->first);
+		int lanes = std::min(workers, rc != rp_count_.end() ? rc->second : 1);
+		rp_bound = std::max(rp_bound, ceilDiv(it->second, std::max(1, lanes)));
+	}
+	f.lower_bound = std::max(f.critical_path, std::max(ceilDiv(f.work, workers), rp_bound));
+	f.upper_bound = ceilDiv(std::max(0LL, f.work - f.critical_path), workers) + f.critical_path;
+	f.upper_bound = std::max(f.upper_bound, f.lower_bound);
+	return f;
+}
+
+std::vector<BuildForecast> Forecaster::forecast(int workers) const {
+	std::vector<BuildForecast> res;
+	for (std::map<int, int>::const_iterator it = build_node_.begin(); it != build_node_.end(); ++it) {
+		if (tree_.remainingNeedRaw(tree_.get(it->second), world_) <= 0) continue;
+		res.push_back(forecastBuilding(it->first, workers));
+	}
+	return res;
+}
+
+BuildForecast Forecaster::forecastBuilding(int building_id, int workers) const {
+	std::map<int, int>::const_iterator it = build_node_.find(building_id);
+	if (it == build_node_.end()) return BuildForecast();
+	BuildForecast f = estimate(std::vector<int>(1, it->second), workers);
+	f.building_id = building_id;
+	f.node_id = it->second;
+	return f;
+}
+
+BuildForecast Forecaster::forecastAll(int workers) const {
+	std::vector<int> roots;
+	for (std::map<int, int>::const_iterator it = build_node_.begin(); it != build_node_.end(); ++it) {
+		if (tree_.remainingNeedRaw(tree_.get(it->second), world_) > 0) roots.push_back(it->second);
+	}
+	return estimate(roots, workers);
+}
@@ -1,50 +1,94 @@
 #include "../includes/Scheduler.hpp"
 #include <algorithm>
+#include <chrono>
 #include <utility>
+#include <set>
 
-Scheduler::Scheduler(WorldState& world) : world_(world) {}
+namespace {
+struct PolicyField {
+	const char* name;
+	double SchedulerPolicy::* field;
+};
+
+const PolicyField kPolicyFields[] = {
+	{"build_value", &SchedulerPolicy::build_value},
+	{"craft_value", &SchedulerPolicy::craft_value},
+	{"craft_shortage", &SchedulerPolicy::craft_shortage},
+	{"gather_shortage", &SchedulerPolicy::gather_shortage},
+	{"distance", &SchedulerPolicy::distance},
+	{"unit_bonus", &SchedulerPolicy::unit_bonus},
+	{"rank_scale", &SchedulerPolicy::rank_scale},
+	{"trade_min_gain", &SchedulerPolicy::trade_min_gain},
+	{"trade_cooldown", &SchedulerPolicy::trade_cooldown},
+};
+}
+
+std::vector<std::pair<std::string, double> > policyParams(const SchedulerPolicy& policy) {
+	std::vector<std::pair<std::string, double> > out;
+	for (size_t i = 0; i < sizeof(kPolicyFields) / sizeof(kPolicyFields[0]); ++i) {
+		out.push_back(std::make_pair(std::string(kPolicyFields[i].name), policy.*kPolicyFields[i].field));
+	}
+	return out;
+}
+
+bool setPolicyParam(SchedulerPolicy& policy, const std::string& name, double value) {
+	for (size_t i = 0; i < sizeof(kPolicyFields) / sizeof(kPolicyFields[0]); ++i) {
+		if (name == kPolicyFields[i].name) {
+			policy.*kPolicyFields[i].field = value;
+			return true;
+		}
+	}
+	return false;
+}
+
+Scheduler::Scheduler(WorldState& world) : world_(world), bom_(world.getCraftingSystem()) {}
 
 std::map<int, int> Scheduler::computeShortage(const TaskTree& tree, const WorldState& world) const {
 	std::map<int, int> need;
+	std::map<int, int> stock;
+	for (std::map<int, Item>::const_iterator it = world.getItems().begin(); it != world.getItems().end(); ++it) {
+		if (it->second.quantity > 0) stock[it->first] = it->second.quantity;
+	}
 	for (const TFNode& n : tree.nodes()) {
 		if (n.item_id >= 10000) continue; // 建筑节点不计入物资缺口
 		int remaining = tree.remainingNeed(n, world);
 		if (remaining <= 0) continue;
 		need[n.item_id] += remaining;
-		// 对 Craft 节点，将材料需求也折算到缺口里，驱动采集/前置生产
+		// 对 Craft 节点，沿物料清单逐级扣除库存后把中间品与原料的净缺口折算进来，驱动采集/前置生产
 		if (n.type == TaskType::Craft) {
-			const CraftingRecipe* r = world.getCraftingSystem().getRecipe(n.crafting_id);
-			if (r) {
-				int batch_out = (r->quantity_produced > 0) ? r->quantity_produced : 1;
-				int batches = (remaining + batch_out - 1) / batch_out;
-				for (size_t mi = 0; mi < r->materials.size(); ++mi) {
-					int need_mat = r->materials[mi].quantity_required * batches;
-					if (need_mat > 0) need[r->materials[mi].item_id] += need_mat;
-				}
+			const CraftingRecipe* r = bom_.recipeFor(n.item_id);
+			if (!r) continue;
+			int batch_out = (r->quantity_produced > 0) ? r->quantity_produced : 1;
+			int batches = (remaining + batch_out - 1) / batch_out;
+			std::map<int, int> gross;
+			for (size_t mi = 0; mi < r->materials.size(); ++mi) {
+				gross[r->materials[mi].item_id] += r->materials[mi].quantity_required * batches;
 			}
+			std::map<int, int> net = bom_.netRequirements(gross, stock);
+			for (std::map<int, int>::const_iterator it = net.begin(); it != net.end(); ++it) need[it->first] += it->second;
 		}
 	}
 	return need;
 }
 
-double Scheduler::scoreTask(const TFNode& node, const Agent& ag, const std::map<int, int>& shortage) const {
+double Scheduler::scoreTask(const TFNode& node, const Agent& ag, const std::map<int, int>& shortage, const TFNodeMeta* meta) const {
 	double value = 0.0;
 	int dist = 0;
 	if (node.type == TaskType::Build) {
-		value = 1e6; // 建造优先级最高
+		value = policy_.build_value; // 建造优先级最高
 		Building* b = world_.getBuilding(node.building_id);
-		int tx = b ? b->x : ag.x;
-		int ty = b ? b->y : ag.y;
+		int tx = meta ? meta->coord.first : (b ? b->x : ag.x);
+		int ty = meta ? meta->coord.second : (b ? b->y : ag.y);
 		dist = ag.getDistanceTo(tx, ty);
 	} else if (node.type == TaskType::Craft) {
-		value = 1e4; // 其次是制造
+		value = policy_.craft_value; // 其次是制造
 		Building* b = nullptr;
 		const CraftingRecipe* recipe = world_.getCraftingSystem().getRecipe(node.crafting_id);
 		if (recipe && recipe->required_building_id > 0) {
 			b = world_.getBuilding(recipe->required_building_id);
 			// 紧缺的成品提高权重
 			std::map<int,int>::const_iterator itNeed = shortage.find(recipe->product_item_id);
-			if (itNeed != shortage.end()) value += itNeed->second * 100.0;
+			if (itNeed != shortage.end()) value += itNeed->second * policy_.craft_shortage;
 		}
 		int tx = b ? b->x : ag.x;
 		int ty = b ? b->y : ag.y;
@@ -52,7 +96,7 @@ double Scheduler::scoreTask(const TFNode& node, const Agent& ag, const std::map<
 	} else { // Gather
 		std::map<int, int>::const_iterator it = shortage.find(node.item_id);
 		int miss = (it != shortage.end()) ? it->second : 0;
-		value = static_cast<double>(miss) * 50.0; // 缺口越大越优先
+		value = static_cast<double>(miss) * policy_.gather_shortage; // 缺口越大越优先
 		int best_dist = 1e9;
 		for (const auto& kv : world_.getResourcePoints()) {
 			if (kv.second.resource_item_id != node.item_id) continue;
@@ -61,7 +105,9 @@ double Scheduler::scoreTask(const TFNode& node, const Agent& ag, const std::map<
 		}
 		dist = (best_dist < 1e9) ? best_dist : 10000;
 	}
-	return (value - 10.0 * dist) * node.priority_weight;
+	// 关键路径：向上秩越大（其后还挂着越长的依赖链）越优先；秩在 TaskTree 中增量维护，出价时只读一个字段
+	if (policy_.rank_scale > 0.0) value *= 1.0 + node.rank / policy_.rank_scale;
+	return (value - policy_.distance * dist) * node.priority_weight;
 }
 
 std::vector<std::pair<int, int> > Scheduler::assign(const TaskTree& tree, const std::vector<int>& ready,
@@ -70,11 +116,12 @@ std::vector<std::pair<int, int> > Scheduler::assign(const TaskTree& tree, const
                                                     const std::vector<int>& current_task,
                                                     const std::vector<int>& /*in_progress*/,
                                                     int current_tick) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 	std::vector<std::pair<int, int> > result;
-	bundles_.assign(agents.size(), std::vector<int>());
-	winners_.assign(tree.nodes().size(), WinInfo());
+	if (bundles_.size() != agents.size()) bundles_.assign(agents.size(), std::vector<int>());
 	if (last_sort_tick_.size() != agents.size()) last_sort_tick_.assign(agents.size(), -1000000);
 	if (last_scores_.size() != agents.size()) last_scores_.assign(agents.size(), std::vector<std::pair<double,int> >());
+	if (agent_sig_.size() != agents.size()) agent_sig_.assign(agents.size(), AgentSig());
 	// 统计进行中的任务数量，避免超额分配
 	std::map<int, int> in_progress_cnt;
 	for (size_t i = 0; i < current_task.size(); ++i) {
@@ -144,94 +191,341 @@ std::vector<std::pair<int, int> > Scheduler::assign(const TaskTree& tree, const
 		if (units > 0) remaining_units[tid] = units;
 	}
 
+	// 候选任务及其材料表；材料可行性与 agent 无关，按任务算一次存成位图，预扣材料时增量更新
+	std::vector<int> cand;
+	std::vector<int> cand_units;
+	std::vector<std::vector<std::pair<int,int> > > cand_mats;
+	std::map<int, int> cand_index; // task_id -> cand 下标
+	std::map<int, std::vector<int> > mat_users; // item_id -> 需要该材料的候选下标
+	for (std::map<int,int>::const_iterator it = remaining_units.begin(); it != remaining_units.end(); ++it) {
+		if (it->second <= 0) continue;
+		const TFNode& n = tree.get(it->first);
+		std::vector<std::pair<int,int> > mats;
+		if (n.type == TaskType::Craft) {
+			const CraftingRecipe* r = world_.getCraftingSystem().getRecipe(n.crafting_id);
+			if (!r) continue;
+			for (size_t mi = 0; mi < r->materials.size(); ++mi) {
+				mats.push_back(std::make_pair(r->materials[mi].item_id, r->materials[mi].quantity_required));
+			}
+		} else if (n.type == TaskType::Build) {
+			Building* b = world_.getBuilding(n.building_id);
+			if (!b) continue;
+			mats = b->required_materials;
+		}
+		int k = static_cast<int>(cand.size());
+		cand.push_back(it->first);
+		cand_units.push_back(it->second);
+		cand_index[it->first] = k;
+		for (size_t mi = 0; mi < mats.size(); ++mi) mat_users[mats[mi].first].push_back(k);
+		cand_mats.push_back(mats);
+	}
+	std::vector<bool> feasible(cand.size(), true);
+	auto refreshFeasible = [&](int k) {
+		bool ok = true;
+		for (size_t mi = 0; mi < cand_mats[k].size(); ++mi) {
+			if (available_items[cand_mats[k][mi].first] < cand_mats[k][mi].second) { ok = false; break; }
+		}
+		feasible[k] = ok;
+	};
+	for (size_t k = 0; k < cand.size(); ++k) refreshFeasible(static_cast<int>(k));
+
 	// 空闲 agent 列表
 	std::vector<int> idle;
 	for (size_t ai = 0; ai < agents.size(); ++ai) {
 		if (current_task[ai] == -1) idle.push_back(static_cast<int>(ai));
 	}
 
-	// CBBA 风格多轮竞价 + bundle 选优
-	const int MAX_ROUND = 3;
-	const int K = 5; // 每个 agent bundle 上限
-	std::vector<std::vector<std::pair<double,int> > > scored_per_agent(agents.size());
+	// 任务签名：影响出价的任务侧输入（剩余批次、缺口、权重）；签名变了的任务需要重新出价
+	std::map<int, TaskSig> sig;
+	for (size_t k = 0; k < cand.size(); ++k) {
+		if (!feasible[k]) continue; // 材料不足（Craft/Build）
+		const TFNode& n = tree.get(cand[k]);
+		TaskSig ts;
+		ts.units = cand_units[k];
+		ts.weight = n.priority_weight;
+		int key = -1;
+		if (n.type == TaskType::Gather) key = n.item_id;
+		else if (n.type == TaskType::Craft) {
+			const CraftingRecipe* r = world_.getCraftingSystem().getRecipe(n.crafting_id);
+			if (r && r->required_building_id > 0) key = r->product_item_id;
+		}
+		std::map<int,int>::const_iterator itNeed = (key >= 0) ? shortage.find(key) : shortage.end();
+		ts.shortage = (itNeed != shortage.end()) ? itNeed->second : 0;
+		sig[cand[k]] = ts;
+	}
+	auto bid = [&](int aid, int tid) -> double {
+		double s = scoreTask(tree.get(tid), *agents[aid], shortage, &tree.meta(tid));
+		s += policy_.unit_bonus * static_cast<double>(sig[tid].units); // 剩余批次数越多，优先级略高
+		++stats_.bids;
+		return s;
+	};
+	// 接受一项分配：前面的获胜者已预扣掉所需材料则放弃；否则预扣（仅对 Craft/Build 一批）并刷新受影响候选的可行位
+	auto take = [&](int aid, int tid) -> bool {
+		int ck = cand_index[tid];
+		if (!feasible[ck]) return false;
+		result.push_back(std::make_pair(tid, aid));
+		for (size_t mi = 0; mi < cand_mats[ck].size(); ++mi) {
+			int mid = cand_mats[ck][mi].first;
+			available_items[mid] -= cand_mats[ck][mi].second;
+			const std::vector<int>& users = mat_users[mid];
+			for (size_t u = 0; u < users.size(); ++u) {
+				if (feasible[users[u]]) refreshFeasible(users[u]);
+			}
+		}
+		return true;
+	};
 
-	for (int round = 0; round < MAX_ROUND; ++round) {
-		bool changed = false;
+	if (consensus_.groups > 0) {
+		// 去中心化 CBBA：每次整表出价，各组线程经消息达成一致后各自取 bundle；不使用修补式缓存
+		winners_.clear();
+		last_sig_.clear();
+		std::vector<int> tasks;
+		for (std::map<int, TaskSig>::const_iterator it = sig.begin(); it != sig.end(); ++it) tasks.push_back(it->first);
+		std::vector<std::vector<double> > bids(idle.size(), std::vector<double>(tasks.size(), 0.0));
+		for (size_t ai = 0; ai < idle.size(); ++ai) {
+			for (size_t k = 0; k < tasks.size(); ++k) bids[ai][k] = bid(idle[ai], tasks[k]);
+		}
+		ConsensusConfig cfg = consensus_;
+		cfg.bundle_limit = 5;
+		std::vector<std::vector<int> > won = ConsensusAuction(cfg).solve(bids, consensus_stats_);
 		for (size_t ai = 0; ai < idle.size(); ++ai) {
 			int aid = idle[ai];
-			bool need_resort = true; // ready/shortage 变化频繁，直接重算保证正确
-			std::vector<std::pair<double,int> > scored;
-			if (need_resort) {
-				for (std::map<int,int>::const_iterator it = remaining_units.begin(); it != remaining_units.end(); ++it) {
-					if (it->second <= 0) continue;
-					int tid = it->first;
-					const TFNode& n = tree.get(tid);
-					if (n.type == TaskType::Gather) {
-						std::map<int,int>::const_iterator itNeed = shortage.find(n.item_id);
-						if (itNeed == shortage.end() || itNeed->second <= 0) continue;
-					}
-					if (n.type == TaskType::Craft) {
-						const CraftingRecipe* r = world_.getCraftingSystem().getRecipe(n.crafting_id);
-						if (r && r->required_building_id > 0) {
-							Building* bNeed = world_.getBuilding(r->required_building_id);
-							if (!bNeed || !bNeed->isCompleted) continue;
-						}
-					}
-					// 检查材料是否足够（Craft/Build）
-					bool feasible = true;
-					if (n.type == TaskType::Craft) {
-						const CraftingRecipe* r = world_.getCraftingSystem().getRecipe(n.crafting_id);
-						if (!r) continue;
-						for (size_t mi = 0; mi < r->materials.size(); ++mi) {
-							int mid = r->materials[mi].item_id;
-							int need = r->materials[mi].quantity_required;
-							int have = available_items[mid];
-							if (have < need) { feasible = false; break; }
-						}
-					} else if (n.type == TaskType::Build) {
-						Building* b = world_.getBuilding(n.building_id);
-						if (!b) continue;
-						for (size_t mi = 0; mi < b->required_materials.size(); ++mi) {
-							int mid = b->required_materials[mi].first;
-							int need = b->required_materials[mi].second;
-							int have = available_items[mid];
-							if (have < need) { feasible = false; break; }
-						}
-					}
-					if (!feasible) continue;
+			std::vector<std::pair<double,int> > mine;
+			for (size_t k = 0; k < won[ai].size(); ++k) mine.push_back(std::make_pair(bids[ai][won[ai][k]], tasks[won[ai][k]]));
+			std::sort(mine.begin(), mine.end(), [](const std::pair<double,int>& a, const std::pair<double,int>& b){ return a.first > b.first; });
+			bundles_[aid].clear();
+			for (size_t k = 0; k < mine.size(); ++k) {
+				bundles_[aid].push_back(mine[k].second);
+				take(aid, mine[k].second);
+			}
+		}
+		return result;
+	}
 
-					double s = scoreTask(n, *agents[aid], shortage);
-					s += 20.0 * static_cast<double>(it->second); // 剩余批次数越多，优先级略高
-					// 简单 bundle 惩罚：已有候选越多，分值略降，鼓励任务分散
-					s -= 50.0 * static_cast<double>(bundles_[aid].size());
-					scored.push_back(std::make_pair(s, tid));
+	if (anytime_budget_us_ > 0) {
+		// 限时竞价：任务按优先级逐个交给出价最高且 bundle 未满的空闲 agent，每个任务前看一次时钟；
+		// 任何时刻 result 都是一份可执行的分配，到期即返回，没轮到的任务记下来下次排在最前
+		winners_.clear();
+		if (bid_cache_.size() != agents.size()) bid_cache_.assign(agents.size(), std::map<int, double>());
+		for (size_t ai = 0; ai < idle.size(); ++ai) {
+			int aid = idle[ai];
+			const AgentSig& as = agent_sig_[aid];
+			if (!as.idle || as.x != agents[aid]->x || as.y != agents[aid]->y) bid_cache_[aid].clear();
+		}
+		for (std::map<int, TaskSig>::const_iterator it = last_sig_.begin(); it != last_sig_.end(); ++it) {
+			std::map<int, TaskSig>::const_iterator now = sig.find(it->first);
+			if (now != sig.end() && now->second == it->second) continue;
+			for (size_t ai = 0; ai < bid_cache_.size(); ++ai) bid_cache_[ai].erase(it->first);
+		}
+		auto cachedBid = [&](int aid, int tid, bool store) -> double {
+			std::map<int, double>& c = bid_cache_[aid];
+			std::map<int, double>::const_iterator it = c.find(tid);
+			if (it != c.end()) {
+				if (store) ++anytime_stats_.cached_bids;
+				return it->second;
+			}
+			double s = bid(aid, tid);
+			if (store) c[tid] = s;
+			return s;
+		};
+
+		// 优先级：建造 > 制作 > 采集，其次向上秩、权重，最后按 id
+		auto before = [&](int a, int b) {
+			const TFNode& na = tree.get(a);
+			const TFNode& nb = tree.get(b);
+			int ka = na.type == TaskType::Build ? 0 : (na.type == TaskType::Craft ? 1 : 2);
+			int kb = nb.type == TaskType::Build ? 0 : (nb.type == TaskType::Craft ? 1 : 2);
+			if (ka != kb) return ka < kb;
+			if (na.rank != nb.rank) return na.rank > nb.rank;
+			if (na.priority_weight != nb.priority_weight) return na.priority_weight > nb.priority_weight;
+			return a < b;
+		};
+		std::vector<int> order;
+		std::set<int> queued;
+		for (size_t k = 0; k < anytime_pending_.size(); ++k) {
+			if (sig.count(anytime_pending_[k]) && queued.insert(anytime_pending_[k]).second) order.push_back(anytime_pending_[k]);
+		}
+		size_t resumed = order.size();
+		for (std::map<int, TaskSig>::const_iterator it = sig.begin(); it != sig.end(); ++it) {
+			if (!queued.count(it->first)) order.push_back(it->first);
+		}
+		std::sort(order.begin() + static_cast<std::ptrdiff_t>(resumed), order.end(), before);
+
+		std::chrono::steady_clock::time_point deadline = start + std::chrono::microseconds(anytime_budget_us_);
+		auto byScore = [](const std::pair<double,int>& a, const std::pair<double,int>& b){ return a.first > b.first; };
+		// 1) 按优先级逐个任务定赢家（出价最高的空闲 agent），每个任务前看一次时钟；至少定下一个任务，保证到期也有进展。
+		// 2) 与修补式竞价相同：各 agent 在自己赢得的任务中按出价从高到低取至多 5 项。第 2 步不出价，总是做完，
+		//    因此任何时刻停下都得到一份可执行的分配；第 1 步跑完时结果与全量竞价一致。
+		// 返回停下的位置；expired 表示因到期停下
+		auto auction = [&](bool bounded, double& score, bool& expired) -> size_t {
+			std::vector<std::vector<std::pair<double,int> > > won(agents.size());
+			size_t k = 0;
+			expired = false;
+			for (; k < order.size(); ++k) {
+				if (bounded && k > 0 && std::chrono::steady_clock::now() >= deadline) {
+					expired = true;
+					break;
 				}
-				std::sort(scored.begin(), scored.end(), [](const std::pair<double,int>& a, const std::pair<double,int>& b){ return a.first > b.first; });
-				last_scores_[aid] = scored;
-				last_sort_tick_[aid] = current_tick;
-			} else {
-				// 过滤缓存中已无效的任务
-				for (size_t k = 0; k < last_scores_[aid].size(); ++k) {
-					int tid = last_scores_[aid][k].second;
-					if (!remaining_units.count(tid)) continue;
-					scored.push_back(last_scores_[aid][k]);
+				int tid = order[k];
+				int best = -1;
+				double best_score = 0.0;
+				for (size_t ai = 0; ai < idle.size(); ++ai) {
+					double s = cachedBid(idle[ai], tid, bounded);
+					if (best < 0 || s > best_score) {
+						best = idle[ai];
+						best_score = s;
+					}
 				}
+				if (best >= 0) won[best].push_back(std::make_pair(best_score, tid));
 			}
-			scored_per_agent[aid] = scored;
-			bundles_[aid].clear();
-			for (size_t k = 0; k < scored.size(); ++k) {
-				int tid = scored[k].second;
-				double s = scored[k].first;
-				if (s > winners_[tid].score) {
-					winners_[tid].score = s;
-					winners_[tid].agent = static_cast<int>(aid);
-					changed = true;
+			for (size_t ai = 0; ai < idle.size(); ++ai) {
+				int aid = idle[ai];
+				std::sort(won[aid].begin(), won[aid].end(), byScore);
+				int limit = 5;
+				for (size_t j = 0; j < won[aid].size() && limit > 0; ++j) {
+					if (!take(aid, won[aid][j].second)) continue;
+					score += won[aid][j].first;
+					--limit;
 				}
-				bundles_[aid].push_back(tid);
 			}
+			return k;
+		};
+
+		std::map<int, int> items_before;
+		std::vector<bool> feasible_before;
+		if (anytime_audit_) {
+			items_before = available_items;
+			feasible_before = feasible;
+		}
+		double score = 0.0;
+		bool expired = false;
+		size_t stop = auction(true, score, expired);
+		long long used = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+		anytime_pending_.clear();
+		if (expired) anytime_pending_.assign(order.begin() + static_cast<std::ptrdiff_t>(stop), order.end());
+
+		anytime_stats_.runs++;
+		anytime_stats_.last_truncated = expired;
+		if (expired) {
+			anytime_stats_.truncated++;
+			anytime_stats_.deferred += static_cast<long long>(anytime_pending_.size());
+		}
+		anytime_stats_.micros_total += used;
+		anytime_stats_.micros_max = std::max(anytime_stats_.micros_max, used);
+		anytime_stats_.score += score;
+		if (anytime_audit_) {
+			double full_score = score;
+			if (expired) {
+				// 从限时分配前的材料状态重跑不限时版本（出价不写入缓存），只取总分
+				std::vector<std::pair<int, int> > kept;
+				kept.swap(result);
+				available_items = items_before;
+				feasible = feasible_before;
+				full_score = 0.0;
+				bool unused = false;
+				auction(false, full_score, unused);
+				result.swap(kept);
+				anytime_stats_.audits++;
+			}
+			anytime_stats_.score_full += full_score;
+		}
+
+		last_sig_.swap(sig);
+		for (size_t ai = 0; ai < agents.size(); ++ai) {
+			agent_sig_[ai].idle = (current_task[ai] == -1);
+			agent_sig_[ai].x = agents[ai]->x;
+			agent_sig_[ai].y = agents[ai]->y;
+		}
+		return result;
+	}
+
+	std::set<int> changed_tasks;
+	for (std::map<int, TaskSig>::const_iterator it = sig.begin(); it != sig.end(); ++it) {
+		std::map<int, TaskSig>::const_iterator old = last_sig_.find(it->first);
+		if (old == last_sig_.end() || !(old->second == it->second)) changed_tasks.insert(it->first);
+	}
+	for (std::map<int, TaskSig>::const_iterator it = last_sig_.begin(); it != last_sig_.end(); ++it) {
+		if (!sig.count(it->first)) changed_tasks.insert(it->first);
+	}
+	// agent 侧：位置变化或新近空闲的 agent 需要整表重算
+	std::vector<char> agent_changed(agents.size(), 0);
+	size_t changed_agents = 0;
+	for (size_t ai = 0; ai < idle.size(); ++ai) {
+		int aid = idle[ai];
+		const AgentSig& as = agent_sig_[aid];
+		if (!as.idle || as.x != agents[aid]->x || as.y != agents[aid]->y) {
+			agent_changed[aid] = 1;
+			++changed_agents;
+		}
+	}
+	size_t change_budget = static_cast<size_t>(repair_threshold_ * static_cast<double>(sig.size() + idle.size()));
+	bool full = winners_.size() != tree.nodes().size()
+	            || changed_tasks.size() + changed_agents > change_budget;
+	if (full) {
+		++stats_.full_auctions;
+		winners_.assign(tree.nodes().size(), WinInfo());
+		changed_tasks.clear();
+		for (std::map<int, TaskSig>::const_iterator it = sig.begin(); it != sig.end(); ++it) changed_tasks.insert(it->first);
+		for (size_t ai = 0; ai < idle.size(); ++ai) agent_changed[idle[ai]] = 1;
+	} else {
+		++stats_.repairs;
+	}
+
+	// 出价：变化的 agent 整表重算；其余 agent 只替换变化任务的出价
+	auto byScore = [](const std::pair<double,int>& a, const std::pair<double,int>& b){ return a.first > b.first; };
+	std::set<int> dirty_tasks(changed_tasks);
+	for (size_t ai = 0; ai < idle.size(); ++ai) {
+		int aid = idle[ai];
+		std::vector<std::pair<double,int> >& scored = last_scores_[aid];
+		if (agent_changed[aid]) {
+			scored.clear();
+			for (std::map<int, TaskSig>::const_iterator it = sig.begin(); it != sig.end(); ++it) {
+				scored.push_back(std::make_pair(bid(aid, it->first), it->first));
+				dirty_tasks.insert(it->first);
+			}
+		} else {
+			std::vector<std::pair<double,int> > kept;
+			for (size_t k = 0; k < scored.size(); ++k) {
+				if (!changed_tasks.count(scored[k].second)) kept.push_back(scored[k]);
+			}
+			for (std::set<int>::const_iterator it = changed_tasks.begin(); it != changed_tasks.end(); ++it) {
+				if (sig.count(*it)) kept.push_back(std::make_pair(bid(aid, *it), *it));
+			}
+			scored.swap(kept);
 		}
-		if (!changed) break;
+		std::sort(scored.begin(), scored.end(), byScore);
+		last_sort_tick_[aid] = current_tick;
+		bundles_[aid].clear();
+		for (size_t k = 0; k < scored.size(); ++k) bundles_[aid].push_back(scored[k].second);
+	}
+	// 赢家不再空闲的任务也要重新竞拍
+	for (std::map<int, TaskSig>::const_iterator it = sig.begin(); it != sig.end(); ++it) {
+		int w = winners_[it->first].agent;
+		if (w < 0 || current_task[w] != -1) dirty_tasks.insert(it->first);
 	}
+	for (std::set<int>::const_iterator it = dirty_tasks.begin(); it != dirty_tasks.end(); ++it) {
+		if (*it >= 0 && *it < static_cast<int>(winners_.size())) winners_[*it] = WinInfo();
+	}
+	// 重新竞拍：只在脏任务上取最高价（同分取 agent 编号小者）
+	for (size_t ai = 0; ai < idle.size(); ++ai) {
+		int aid = idle[ai];
+		const std::vector<std::pair<double,int> >& scored = last_scores_[aid];
+		for (size_t k = 0; k < scored.size(); ++k) {
+			int tid = scored[k].second;
+			if (!dirty_tasks.count(tid)) continue;
+			if (scored[k].first > winners_[tid].score) {
+				winners_[tid].score = scored[k].first;
+				winners_[tid].agent = aid;
+			}
+		}
+	}
+	last_sig_.swap(sig);
+	for (size_t ai = 0; ai < agents.size(); ++ai) {
+		agent_sig_[ai].idle = (current_task[ai] == -1);
+		agent_sig_[ai].x = agents[ai]->x;
+		agent_sig_[ai].y = agents[ai]->y;
+	}
+	std::vector<std::vector<std::pair<double,int> > >& scored_per_agent = last_scores_;
 
 	// 选取每个 agent 在自己赢得的 bundle 中分值最高的任务
 	for (size_t ai = 0; ai < idle.size(); ++ai) {
@@ -240,25 +534,7 @@ std::vector<std::pair<int, int> > Scheduler::assign(const TaskTree& tree, const
 		for (size_t k = 0; k < scored_per_agent[aid].size() && limit > 0; ++k) {
 			int tid = scored_per_agent[aid][k].second;
 			if (winners_[tid].agent != aid) continue;
-			result.push_back(std::make_pair(tid, aid));
-			--limit;
-			// 预扣材料，确保后续分配不会超额（这里仅对 Craft/Build 一批）
-			const TFNode& n = tree.get(tid);
-			if (n.type == TaskType::Craft) {
-				const CraftingRecipe* r = world_.getCraftingSystem().getRecipe(n.crafting_id);
-				if (r) {
-					for (size_t mi = 0; mi < r->materials.size(); ++mi) {
-						available_items[r->materials[mi].item_id] -= r->materials[mi].quantity_required;
-					}
-				}
-			} else if (n.type == TaskType::Build) {
-				Building* b = world_.getBuilding(n.building_id);
-				if (b) {
-					for (size_t mi = 0; mi < b->required_materials.size(); ++mi) {
-						available_items[b->required_materials[mi].first] -= b->required_materials[mi].second;
-					}
-				}
-			}
+			if (take(aid, tid)) --limit;
 		}
 	}
 
@@ -0,0 +1,375 @@
+#include "../includes/SchedulingService.hpp"
+#include "../includes/DatabaseInitializer.hpp"
+#include "../includes/WorkerInit.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+const size_t kMaxBatch = 256;
+const size_t kMaxLatencySamples = 1 << 20;
+
+long long nowMicros() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+	    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+}
+
+struct SchedulingService::Session {
+	explicit Session(DatabaseManager& db) : world(db), scheduler(world) {}
+	~Session() {
+		for (size_t i = 0; i < agents.size(); ++i) delete agents[i];
+	}
+	WorldState world;
+	TaskTree tree;
+	Scheduler scheduler;
+	std::vector<Agent*> agents;
+	std::vector<int> current_task;
+	std::vector<int> current_batch;
+	int tick = 0;
+};
+
+struct SchedulingService::Connection {
+	int fd = -1;
+	std::vector<unsigned char> in;
+};
+
+struct SchedulingService::Request {
+	int fd = -1;
+	svc::FrameHeader header;
+	std::vector<unsigned char> payload;
+	long long recv_us = 0;
+	uint16_t status = svc::StatusOk;
+	std::vector<unsigned char> out;
+};
+
+// 固定线程数的工作池：run 提交一批任务并阻塞到全部完成
+class SchedulingService::WorkerPool {
+public:
+	explicit WorkerPool(int n) {
+		for (int i = 0; i < n; ++i) threads_.push_back(std::thread(&WorkerPool::loop, this));
+	}
+	~WorkerPool() {
+		{
+			std::lock_guard<std::mutex> lock(mu_);
+			stop_ = true;
+		}
+		cv_.notify_all();
+		for (size_t i = 0; i < threads_.size(); ++i) threads_[i].join();
+	}
+	void run(std::vector<std::function<void()> >& jobs) {
+		if (threads_.empty() || jobs.size() == 1) {
+			for (size_t i = 0; i < jobs.size(); ++i) jobs[i]();
+			return;
+		}
+		std::unique_lock<std::mutex> lock(mu_);
+		for (size_t i = 0; i < jobs.size(); ++i) queue_.push_back(jobs[i]);
+		pending_ += jobs.size();
+		cv_.notify_all();
+		done_cv_.wait(lock, [this]() { return pending_ == 0; });
+	}
+
+private:
+	void loop() {
+		for (;;) {
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(mu_);
+				cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+				if (stop_ && queue_.empty()) return;
+				job = queue_.front();
+				queue_.pop_front();
+			}
+			job();
+			std::lock_guard<std::mutex> lock(mu_);
+			if (--pending_ == 0) done_cv_.notify_all();
+		}
+	}
+
+	std::vector<std::thread> threads_;
+	std::mutex mu_;
+	std::condition_variable cv_;
+	std::condition_variable done_cv_;
+	std::deque<std::function<void()> > queue_;
+	size_t pending_ = 0;
+	bool stop_ = false;
+};
+
+SchedulingService::SchedulingService(DatabaseManager& db, int workers, int batch_window_us)
+: db_(db), batch_window_us_(std::max(0, batch_window_us)), pool_(new WorkerPool(std::max(0, workers))), running_(false) {}
+
+SchedulingService::~SchedulingService() {
+	for (std::map<int, std::unique_ptr<Connection> >::iterator it = conns_.begin(); it != conns_.end(); ++it) close(it->first);
+	if (listen_fd_ >= 0) {
+		close(listen_fd_);
+		unlink(socket_path_.c_str());
+	}
+}
+
+bool SchedulingService::listen(const std::string& socket_path) {
+	sockaddr_un addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if (socket_path.empty() || socket_path.size() >= sizeof(addr.sun_path)) {
+		std::cerr << "Socket path too long: " << socket_path << std::endl;
+		return false;
+	}
+	std::strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0) return false;
+	unlink(socket_path.c_str());
+	if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, 64) != 0) {
+		std::cerr << "Failed to listen on " << socket_path << ": " << std::strerror(errno) << std::endl;
+		close(fd);
+		return false;
+	}
+	listen_fd_ = fd;
+	socket_path_ = socket_path;
+	return true;
+}
+
+void SchedulingService::serve() {
+	if (listen_fd_ < 0) return;
+	running_ = true;
+	while (running_) {
+		std::vector<pollfd> fds;
+		pollfd lp = {listen_fd_, POLLIN, 0};
+		fds.push_back(lp);
+		for (std::map<int, std::unique_ptr<Connection> >::iterator it = conns_.begin(); it != conns_.end(); ++it) {
+			pollfd p = {it->first, POLLIN, 0};
+			fds.push_back(p);
+		}
+		// 批内有请求时只等到窗口结束；否则定期醒来检查 stop
+		long long wait_us = 100000;
+		if (!batch_.empty()) wait_us = std::max(0LL, batch_start_us_ + batch_window_us_ - nowMicros());
+		timespec ts = {static_cast<time_t>(wait_us / 1000000), static_cast<long>((wait_us % 1000000) * 1000)};
+		int ready = ppoll(fds.data(), fds.size(), &ts, nullptr);
+		if (ready < 0 && errno != EINTR) break;
+
+		if (ready > 0) {
+			if (fds[0].revents & POLLIN) acceptClients();
+			long long now = nowMicros();
+			for (size_t i = 1; i < fds.size(); ++i) {
+				if (!fds[i].revents) continue;
+				std::map<int, std::unique_ptr<Connection> >::iterator it = conns_.find(fds[i].fd);
+				if (it == conns_.end()) continue;
+				if (!readClient(*it->second, now)) {
+					close(it->first);
+					conns_.erase(it);
+				}
+			}
+		}
+		if (!batch_.empty() && (batch_.size() >= kMaxBatch || nowMicros() - batch_start_us_ >= batch_window_us_)) {
+			processBatch();
+		}
+	}
+	if (!batch_.empty()) processBatch();
+}
+
+void SchedulingService::acceptClients() {
+	int fd = accept(listen_fd_, nullptr, nullptr);
+	if (fd < 0) return;
+	std::unique_ptr<Connection> c(new Connection());
+	c->fd = fd;
+	conns_[fd] = std::move(c);
+}
+
+bool SchedulingService::readClient(Connection& c, long long now_us) {
+	unsigned char buf[65536];
+	ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+	if (n <= 0) return false;
+	c.in.insert(c.in.end(), buf, buf + n);
+	size_t off = 0;
+	while (c.in.size() - off >= svc::kHeaderSize) {
+		svc::FrameHeader h = svc::decodeHeader(c.in.data() + off);
+		if (h.length > svc::kMaxPayload || h.length % 4 != 0) return false; // 协议错误，断开
+		if (c.in.size() - off < svc::kHeaderSize + h.length) break;
+		std::unique_ptr<Request> req(new Request());
+		req->fd = c.fd;
+		req->header = h;
+		const unsigned char* body = c.in.data() + off + svc::kHeaderSize;
+		req->payload.assign(body, body + h.length);
+		req->recv_us = now_us;
+		if (batch_.empty()) batch_start_us_ = now_us;
+		batch_.push_back(std::move(req));
+		off += svc::kHeaderSize + h.length;
+	}
+	c.in.erase(c.in.begin(), c.in.begin() + off);
+	return true;
+}
+
+void SchedulingService::processBatch() {
+	// 1) 串行：创建会话、统计、非法请求
+	std::map<uint32_t, std::vector<Request*> > per_session;
+	std::vector<Request*> destroys;
+	for (size_t i = 0; i < batch_.size(); ++i) {
+		Request& req = *batch_[i];
+		const std::vector<unsigned char>& p = req.payload;
+		switch (req.header.op) {
+		case svc::OpCreate: {
+			if (p.size() < 12) { req.status = svc::StatusBadRequest; break; }
+			int w = svc::getI32(&p[0]);
+			int h = svc::getI32(&p[4]);
+			int n = svc::getI32(&p[8]);
+			if (w <= 0 || h <= 0 || n < 0 || n > 4096) { req.status = svc::StatusBadRequest; break; }
+			std::unique_ptr<Session> s(new Session(db_));
+			s->world.CreateRandomWorld(w, h);
+			s->tree.buildFromDatabase(s->world.getCraftingSystem(), s->world.getBuildings());
+			s->agents = initDefaultWorkers(n, &s->world.getCraftingSystem());
+			s->current_task.assign(n, -1);
+			s->current_batch.assign(n, 0);
+			req.header.session_id = next_session_++;
+			sessions_[req.header.session_id] = std::move(s);
+			break;
+		}
+		case svc::OpStats: {
+			LatencySummary l = latency();
+			svc::putU32(req.out, static_cast<uint32_t>(l.count));
+			svc::putU32(req.out, static_cast<uint32_t>(l.p50));
+			svc::putU32(req.out, static_cast<uint32_t>(l.p90));
+			svc::putU32(req.out, static_cast<uint32_t>(l.p99));
+			svc::putU32(req.out, static_cast<uint32_t>(l.max));
+			break;
+		}
+		case svc::OpDelta:
+		case svc::OpAssign:
+		case svc::OpDestroy:
+			if (!sessions_.count(req.header.session_id)) { req.status = svc::StatusNoSession; break; }
+			if (req.header.op == svc::OpDestroy) destroys.push_back(&req);
+			else per_session[req.header.session_id].push_back(&req);
+			break;
+		default:
+			req.status = svc::StatusBadRequest;
+		}
+	}
+
+	// 2) 并行：每个会话一个任务，会话内按到达顺序
+	std::vector<std::function<void()> > jobs;
+	for (std::map<uint32_t, std::vector<Request*> >::iterator it = per_session.begin(); it != per_session.end(); ++it) {
+		Session* s = sessions_[it->first].get();
+		std::vector<Request*>* ops = &it->second;
+		jobs.push_back([this, s, ops]() { handleSessionOps(*s, *ops); });
+	}
+	if (!jobs.empty()) pool_->run(jobs);
+
+	// 3) 销毁会话，统一回包
+	for (size_t i = 0; i < destroys.size(); ++i) sessions_.erase(destroys[i]->header.session_id);
+	for (size_t i = 0; i < batch_.size(); ++i) reply(*batch_[i]);
+	batch_.clear();
+}
+
+void SchedulingService::handleSessionOps(Session& s, std::vector<Request*>& ops) {
+	for (size_t i = 0; i < ops.size(); ++i) {
+		if (ops[i]->header.op == svc::OpDelta) applyDelta(s, *ops[i]);
+		else assign(s, *ops[i]);
+	}
+}
+
+void SchedulingService::applyDelta(Session& s, Request& req) {
+	const std::vector<unsigned char>& p = req.payload;
+	if (p.size() % 16 != 0) { req.status = svc::StatusBadRequest; return; }
+	for (size_t off = 0; off < p.size(); off += 16) {
+		int kind = svc::getI32(&p[off]);
+		int a = svc::getI32(&p[off + 4]);
+		int b = svc::getI32(&p[off + 8]);
+		int c = svc::getI32(&p[off + 12]);
+		bool agent_ok = a >= 0 && a < static_cast<int>(s.agents.size());
+		if (kind == svc::DeltaItem) {
+			if (b > 0) s.world.addItem(a, b);
+			else if (b < 0) s.world.removeItem(a, -b);
+		} else if (kind == svc::DeltaBuildingDone) {
+			const Building* bd = s.world.getBuilding(a);
+			if (!bd) { req.status = svc::StatusBadRequest; continue; }
+			s.tree.applyEvent(TaskInfo{1, a, 0, 0, std::make_pair(bd->x, bd->y)}, s.world);
+		} else if (kind == svc::DeltaAgentMove && agent_ok) {
+			s.agents[a]->x = b;
+			s.agents[a]->y = c;
+		} else if (kind == svc::DeltaAgentDone && agent_ok) {
+			int tid = s.current_task[a];
+			if (tid >= 0) {
+				TFNode& n = s.tree.get(tid);
+				n.allocated = std::max(0, n.allocated - s.current_batch[a]);
+			}
+			s.current_task[a] = -1;
+			s.current_batch[a] = 0;
+		} else {
+			req.status = svc::StatusBadRequest;
+		}
+	}
+}
+
+void SchedulingService::assign(Session& s, Request& req) {
+	s.tree.syncWithWorld(s.world);
+	s.world.clearDirty();
+	std::map<int, int> shortage = s.scheduler.computeShortage(s.tree, s.world);
+	std::vector<int> ready = s.tree.ready(s.world);
+	std::vector<std::pair<int,int> > plan = s.scheduler.assign(s.tree, ready, s.agents, shortage,
+	                                                           s.current_task, s.current_task, s.tick++);
+	// 与 Simulator::applyPlan 相同的锁定批量；每个空闲 agent 只拉起一项
+	for (size_t i = 0; i < plan.size(); ++i) {
+		int tid = plan[i].first;
+		int aid = plan[i].second;
+		if (aid < 0 || aid >= static_cast<int>(s.agents.size()) || s.current_task[aid] != -1) continue;
+		TFNode& n = s.tree.get(tid);
+		int batch = 1;
+		if (n.type == TaskType::Gather) batch = 10;
+		else if (n.type == TaskType::Craft) {
+			const CraftingRecipe* r = s.world.getCraftingSystem().getRecipe(n.crafting_id);
+			if (r && r->quantity_produced > 0) batch = r->quantity_produced;
+		}
+		n.allocated += batch;
+		s.current_task[aid] = tid;
+		s.current_batch[aid] = batch;
+		svc::putI32(req.out, aid);
+		svc::putI32(req.out, tid);
+		svc::putI32(req.out, static_cast<int>(n.type));
+		svc::putI32(req.out, n.type == TaskType::Build ? n.building_id : n.item_id);
+	}
+}
+
+void SchedulingService::reply(Request& req) {
+	std::map<int, std::unique_ptr<Connection> >::iterator it = conns_.find(req.fd);
+	if (it == conns_.end()) return; // 客户端已断开
+	svc::FrameHeader h = req.header;
+	h.op = static_cast<uint16_t>(h.op | svc::OpReply);
+	h.status = req.status;
+	std::vector<unsigned char> frame;
+	svc::encodeFrame(frame, h, req.out);
+	size_t sent = 0;
+	while (sent < frame.size()) {
+		ssize_t n = send(req.fd, frame.data() + sent, frame.size() - sent, MSG_NOSIGNAL);
+		if (n <= 0) {
+			if (n < 0 && errno == EINTR) continue;
+			return;
+		}
+		sent += static_cast<size_t>(n);
+	}
+	if (latencies_us_.size() >= kMaxLatencySamples) {
+		latencies_us_.erase(latencies_us_.begin(), latencies_us_.begin() + kMaxLatencySamples / 2);
+	}
+	latencies_us_.push_back(nowMicros() - req.recv_us);
+}
+
+LatencySummary SchedulingService::latency() const {
+	LatencySummary l;
+	if (latencies_us_.empty()) return l;
+	std::vector<long long> v(latencies_us_);
+	std::sort(v.begin(), v.end());
+	l.count = v.size();
+	// nearest-rank 百分位
+	l.p50 = v[(v.size() * 50 + 99) / 100 - 1];
+	l.p90 = v[(v.size() * 90 + 99) / 100 - 1];
+	l.p99 = v[(v.size() * 99 + 99) / 100 - 1];
+	l.max = v.back();
+	return l;
+}
@@ -0,0 +1,417 @@
+#include "../includes/ShardedSimulator.hpp"
+#include "../includes/DatabaseInitializer.hpp"
+#include "../includes/WorkerInit.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <future>
+#include <iostream>
+#include <set>
+#include <string>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+// 屏障消息：u32 个数 + int32 序列（同机父子进程，按本机字节序）
+bool writeAll(int fd, const void* data, size_t len) {
+	const char* p = static_cast<const char*>(data);
+	while (len > 0) {
+		ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+		if (n <= 0) return false;
+		p += n;
+		len -= static_cast<size_t>(n);
+	}
+	return true;
+}
+
+bool readAll(int fd, void* data, size_t len) {
+	char* p = static_cast<char*>(data);
+	while (len > 0) {
+		ssize_t n = recv(fd, p, len, 0);
+		if (n <= 0) return false;
+		p += n;
+		len -= static_cast<size_t>(n);
+	}
+	return true;
+}
+
+bool sendMessage(int fd, const std::vector<int32_t>& msg) {
+	uint32_t n = static_cast<uint32_t>(msg.size());
+	return writeAll(fd, &n, sizeof(n)) && (n == 0 || writeAll(fd, msg.data(), n * sizeof(int32_t)));
+}
+
+bool recvMessage(int fd, std::vector<int32_t>& msg) {
+	uint32_t n = 0;
+	if (!readAll(fd, &n, sizeof(n))) return false;
+	msg.resize(n);
+	return n == 0 || readAll(fd, msg.data(), n * sizeof(int32_t));
+}
+
+void putMap(std::vector<int32_t>& out, const std::map<int, int>& m) {
+	out.push_back(static_cast<int32_t>(m.size()));
+	for (std::map<int, int>::const_iterator it = m.begin(); it != m.end(); ++it) {
+		out.push_back(it->first);
+		out.push_back(it->second);
+	}
+}
+
+void putPairs(std::vector<int32_t>& out, const std::vector<std::pair<int, int> >& v) {
+	out.push_back(static_cast<int32_t>(v.size()));
+	for (size_t i = 0; i < v.size(); ++i) {
+		out.push_back(v[i].first);
+		out.push_back(v[i].second);
+	}
+}
+
+void getMap(const std::vector<int32_t>& in, size_t& pos, std::map<int, int>& m) {
+	int n = pos < in.size() ? in[pos++] : 0;
+	for (int i = 0; i < n && pos + 1 < in.size(); ++i, pos += 2) m[in[pos]] = in[pos + 1];
+}
+
+void getPairs(const std::vector<int32_t>& in, size_t& pos, std::vector<std::pair<int, int> >& v) {
+	int n = pos < in.size() ? in[pos++] : 0;
+	for (int i = 0; i < n && pos + 1 < in.size(); ++i, pos += 2) v.push_back(std::make_pair(in[pos], in[pos + 1]));
+}
+
+std::vector<int32_t> encodeReport(const ShardedSimulator::Report& r) {
+	std::vector<int32_t> out;
+	out.push_back(r.shard);
+	out.push_back(r.finished ? 1 : 0);
+	out.push_back(r.remaining_buildings);
+	out.push_back(r.agents);
+	putMap(out, r.inventory);
+	putMap(out, r.want);
+	putPairs(out, r.built);
+	putPairs(out, r.leaving);
+	return out;
+}
+
+ShardedSimulator::Report decodeReport(const std::vector<int32_t>& in) {
+	ShardedSimulator::Report r;
+	if (in.size() < 4) return r;
+	r.shard = in[0];
+	r.finished = in[1] != 0;
+	r.remaining_buildings = in[2];
+	r.agents = in[3];
+	size_t pos = 4;
+	getMap(in, pos, r.inventory);
+	getMap(in, pos, r.want);
+	getPairs(in, pos, r.built);
+	getPairs(in, pos, r.leaving);
+	return r;
+}
+
+std::vector<int32_t> encodeGrant(const ShardedSimulator::Grant& g) {
+	std::vector<int32_t> out;
+	out.push_back(g.stop ? 1 : 0);
+	out.push_back(g.ticks);
+	putMap(out, g.delta);
+	putPairs(out, g.arriving);
+	return out;
+}
+
+ShardedSimulator::Grant decodeGrant(const std::vector<int32_t>& in) {
+	ShardedSimulator::Grant g;
+	if (in.size() < 2) return g;
+	g.stop = in[0] != 0;
+	g.ticks = in[1];
+	size_t pos = 2;
+	getMap(in, pos, g.delta);
+	getPairs(in, pos, g.arriving);
+	return g;
+}
+
+} // namespace
+
+struct ShardedSimulator::Shard {
+	explicit Shard(DatabaseManager& db) : world(db), scheduler(world) {}
+	~Shard() {
+		sim.reset();
+		for (size_t i = 0; i < agents.size(); ++i) delete agents[i];
+	}
+	int index = 0;
+	int ox = 0, oy = 0;
+	WorldState world;
+	TaskTree tree;
+	Scheduler scheduler;
+	std::vector<Agent*> agents;
+	std::unique_ptr<Simulator> sim;
+	bool started = false;
+	bool finished = false;
+	bool handed_off = false;
+	std::vector<std::pair<int, int> > built; // 自上次上报以来建成的 (building_id, tick)
+};
+
+ShardedSimulator::ShardedSimulator(DatabaseManager& db, int shards, int region_width, int region_height, int agents_per_shard) {
+	int k = std::max(1, shards);
+	int cols = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(k))));
+	for (int i = 0; i < k; ++i) {
+		std::unique_ptr<Shard> s(new Shard(db));
+		s->index = i;
+		s->ox = (i % cols) * region_width;
+		s->oy = (i / cols) * region_height;
+		// 按区域大小生成一份内容再整体平移，各区域互不重叠
+		s->world.CreateRandomWorld(region_width, region_height);
+		for (std::map<int, ResourcePoint>::iterator it = s->world.getResourcePoints().begin(); it != s->world.getResourcePoints().end(); ++it) {
+			it->second.x += s->ox;
+			it->second.y += s->oy;
+		}
+		for (std::map<int, Building>::iterator it = s->world.getBuildings().begin(); it != s->world.getBuildings().end(); ++it) {
+			it->second.x += s->ox;
+			it->second.y += s->oy;
+		}
+		s->tree.buildFromDatabase(s->world.getCraftingSystem(), s->world.getBuildings());
+		s->agents = initDefaultWorkers(agents_per_shard, &s->world.getCraftingSystem());
+		for (size_t a = 0; a < s->agents.size(); ++a) {
+			s->agents[a]->x = s->ox + region_width / 2;
+			s->agents[a]->y = s->oy + region_height / 2;
+		}
+		s->sim.reset(new Simulator(s->world, s->tree, s->scheduler, s->agents));
+		s->sim->setLogPath(std::string());
+		Shard* raw = s.get();
+		s->sim->setEventCallback([raw](const SimEvent& ev) {
+			if (ev.type == 1) raw->built.push_back(std::make_pair(ev.target_id, ev.tick));
+		});
+		shards_.push_back(std::move(s));
+	}
+}
+
+ShardedSimulator::~ShardedSimulator() {}
+
+ShardedSimulator::Report ShardedSimulator::advance(Shard& s, const Grant& g) {
+	for (std::map<int, int>::const_iterator it = g.delta.begin(); it != g.delta.end(); ++it) {
+		if (it->second > 0) s.world.addItem(it->first, it->second);
+		else s.world.removeItem(it->first, -it->second);
+	}
+	for (size_t i = 0; i < g.arriving.size(); ++i) {
+		std::string name = "Worker_S" + std::to_string(s.index) + "_" + std::to_string(s.agents.size() + 1);
+		s.agents.push_back(new Agent(name, "Worker", 100, g.arriving[i].first, g.arriving[i].second, &s.world.getCraftingSystem()));
+	}
+	if (!s.started) {
+		s.sim->begin();
+		s.started = true;
+	}
+	if (!s.finished && g.ticks > 0) s.sim->step(g.ticks);
+
+	Report r;
+	r.shard = s.index;
+	for (std::map<int, Building>::const_iterator it = s.world.getBuildings().begin(); it != s.world.getBuildings().end(); ++it) {
+		if (it->first == 256) continue; // storage
+		if (!it->second.isCompleted) r.remaining_buildings++;
+	}
+	s.finished = r.remaining_buildings == 0;
+	r.finished = s.finished;
+	for (std::map<int, Item>::const_iterator it = s.world.getItems().begin(); it != s.world.getItems().end(); ++it) {
+		if (it->first >= 10000 || it->second.quantity <= 0) continue; // 建筑伪 ID 不入账
+		r.inventory[it->first] = it->second.quantity;
+	}
+	if (!s.finished) {
+		for (size_t n = 0; n < s.tree.nodes().size(); ++n) {
+			const TFNode& node = s.tree.nodes()[n];
+			if (node.type == TaskType::Build || node.item_id >= 10000 || node.demand <= 0) continue;
+			r.want[node.item_id] += node.demand;
+		}
+	}
+	r.built.swap(s.built);
+	if (s.finished && !s.handed_off) {
+		for (size_t a = 0; a < s.agents.size(); ++a) r.leaving.push_back(std::make_pair(s.agents[a]->x, s.agents[a]->y));
+		s.handed_off = true;
+	}
+	r.agents = s.handed_off ? 0 : static_cast<int>(s.agents.size());
+	return r;
+}
+
+void ShardedSimulator::reconcile(std::vector<Report>& reports, std::vector<Grant>& grants, ShardStats& stats) {
+	size_t k = reports.size();
+	grants.assign(k, Grant());
+	std::set<int> items;
+	for (std::map<int, int>::const_iterator it = ledger_.begin(); it != ledger_.end(); ++it) items.insert(it->first);
+	for (size_t s = 0; s < k; ++s) {
+		for (std::map<int, int>::const_iterator it = reports[s].inventory.begin(); it != reports[s].inventory.end(); ++it) items.insert(it->first);
+		for (std::map<int, int>::const_iterator it = reports[s].want.begin(); it != reports[s].want.end(); ++it) items.insert(it->first);
+	}
+
+	// 库存对账：本地需求内的部分原地保留，余量归入全局账本，再从账本补给不足的分片（起点每个 epoch 轮转）
+	size_t start = static_cast<size_t>(epoch_index_) % k;
+	for (std::set<int>::const_iterator it = items.begin(); it != items.end(); ++it) {
+		int item = *it;
+		long long pool = ledger_.count(item) ? ledger_[item] : 0;
+		std::vector<int> inv(k, 0), want(k, 0), grant(k, 0);
+		for (size_t s = 0; s < k; ++s) {
+			std::map<int, int>::const_iterator a = reports[s].inventory.find(item);
+			std::map<int, int>::const_iterator b = reports[s].want.find(item);
+			inv[s] = a != reports[s].inventory.end() ? a->second : 0;
+			want[s] = b != reports[s].want.end() ? b->second : 0;
+			grant[s] = std::min(inv[s], want[s]);
+			pool += inv[s] - grant[s];
+		}
+		for (size_t j = 0; j < k && pool > 0; ++j) {
+			size_t s = (start + j) % k;
+			int extra = static_cast<int>(std::min<long long>(pool, want[s] - grant[s]));
+			if (extra <= 0) continue;
+			grant[s] += extra;
+			pool -= extra;
+		}
+		if (pool > 0) ledger_[item] = static_cast<int>(pool);
+		else ledger_.erase(item);
+		for (size_t s = 0; s < k; ++s) {
+			int delta = grant[s] - inv[s];
+			if (delta == 0) continue;
+			grants[s].delta[item] = delta;
+			if (delta > 0) stats.items_moved += delta;
+		}
+	}
+
+	// agent 移交：完工分片的 agent 逐个交给 剩余建筑数 / (agent 数 + 1) 最大的未完工分片
+	std::vector<int> load(k, 0);
+	for (size_t s = 0; s < k; ++s) load[s] = reports[s].agents;
+	for (size_t s = 0; s < k; ++s) {
+		for (size_t a = 0; a < reports[s].leaving.size(); ++a) {
+			int best = -1;
+			double best_ratio = 0.0;
+			for (size_t r = 0; r < k; ++r) {
+				if (reports[r].finished) continue;
+				double ratio = static_cast<double>(reports[r].remaining_buildings) / (load[r] + 1);
+				if (best < 0 || ratio > best_ratio) { best = static_cast<int>(r); best_ratio = ratio; }
+			}
+			if (best < 0) break; // 全部完工，无处可去
+			grants[best].arriving.push_back(reports[s].leaving[a]);
+			load[best]++;
+			stats.handoffs++;
+		}
+		for (size_t b = 0; b < reports[s].built.size(); ++b) {
+			ShardBuild sb = {reports[s].shard, reports[s].built[b].first, reports[s].built[b].second};
+			stats.builds.push_back(sb);
+		}
+	}
+	epoch_index_++;
+}
+
+ShardStats ShardedSimulator::run(int max_ticks) {
+	ShardStats stats;
+	epoch_index_ = 0;
+	ledger_.clear();
+	if (process_mode_) runProcesses(max_ticks, stats);
+	else runThreads(max_ticks, stats);
+	stats.ledger = ledger_;
+	return stats;
+}
+
+void ShardedSimulator::runThreads(int max_ticks, ShardStats& stats) {
+	size_t k = shards_.size();
+	std::vector<Grant> grants(k);
+	std::vector<Report> reports(k);
+	int ticks = 0;
+	for (;;) {
+		int step = std::min(epoch_, max_ticks - ticks);
+		std::vector<std::future<Report> > futures;
+		for (size_t s = 0; s < k; ++s) {
+			Shard* shard = shards_[s].get();
+			const Grant* g = &grants[s];
+			grants[s].ticks = step;
+			futures.push_back(std::async(std::launch::async, [this, shard, g]() { return advance(*shard, *g); }));
+		}
+		bool all_finished = true;
+		for (size_t s = 0; s < k; ++s) {
+			reports[s] = futures[s].get();
+			if (!reports[s].finished) all_finished = false;
+		}
+		ticks += step;
+		stats.epochs++;
+		reconcile(reports, grants, stats);
+		if (all_finished || ticks >= max_ticks) break;
+	}
+	stats.ticks = ticks;
+	for (size_t s = 0; s < k; ++s) {
+		if (shards_[s]->started) shards_[s]->sim->finish();
+	}
+}
+
+void ShardedSimulator::runProcesses(int max_ticks, ShardStats& stats) {
+	size_t k = shards_.size();
+	std::vector<int> fds;
+	std::vector<pid_t> pids;
+	std::cout.flush();
+	std::cerr.flush();
+	for (size_t s = 0; s < k; ++s) {
+		int sv[2];
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0) break;
+		pid_t pid = fork();
+		if (pid < 0) {
+			close(sv[0]);
+			close(sv[1]);
+			break;
+		}
+		if (pid == 0) {
+			// 子进程：只推进自己的分片，按屏障收发消息
+			close(sv[0]);
+			for (size_t i = 0; i < fds.size(); ++i) close(fds[i]);
+			int code = 0;
+			try {
+				std::vector<int32_t> msg;
+				while (recvMessage(sv[1], msg)) {
+					Grant g = decodeGrant(msg);
+					if (g.stop) break;
+					Report r = advance(*shards_[s], g);
+					if (!sendMessage(sv[1], encodeReport(r))) { code = 1; break; }
+				}
+				if (shards_[s]->started) shards_[s]->sim->finish();
+			} catch (...) {
+				code = 1;
+			}
+			_exit(code);
+		}
+		close(sv[1]);
+		fds.push_back(sv[0]);
+		pids.push_back(pid);
+	}
+	if (fds.size() != k) {
+		std::cerr << "Failed to start shard processes, falling back to threads" << std::endl;
+		Grant stop;
+		stop.stop = true;
+		for (size_t i = 0; i < fds.size(); ++i) {
+			sendMessage(fds[i], encodeGrant(stop));
+			close(fds[i]);
+			waitpid(pids[i], nullptr, 0);
+		}
+		runThreads(max_ticks, stats);
+		return;
+	}
+
+	std::vector<Grant> grants(k);
+	std::vector<Report> reports(k);
+	int ticks = 0;
+	bool ok = true;
+	while (ok) {
+		int step = std::min(epoch_, max_ticks - ticks);
+		for (size_t s = 0; s < k && ok; ++s) {
+			grants[s].ticks = step;
+			ok = sendMessage(fds[s], encodeGrant(grants[s]));
+		}
+		bool all_finished = true;
+		for (size_t s = 0; s < k && ok; ++s) {
+			std::vector<int32_t> msg;
+			ok = recvMessage(fds[s], msg);
+			reports[s] = decodeReport(msg);
+			if (!reports[s].finished) all_finished = false;
+		}
+		if (!ok) {
+			std::cerr << "Shard process exited unexpectedly" << std::endl;
+			break;
+		}
+		ticks += step;
+		stats.epochs++;
+		reconcile(reports, grants, stats);
+		if (all_finished || ticks >= max_ticks) break;
+	}
+	stats.ticks = ticks;
+	Grant stop;
+	stop.stop = true;
+	for (size_t s = 0; s < k; ++s) {
+		sendMessage(fds[s], encodeGrant(stop));
+		close(fds[s]);
+		waitpid(pids[s], nullptr, 0);
+	}
+}
@@ -5,542 +5,1204 @@
 #include <set>
 #include <random>
 #include <algorithm>
+#include <chrono>
+
+namespace {
+// debug_flag: 0 = no debug; 1 = basic (shortage/needs/tasks for visualizer); 2 = verbose (ready/blocked/assign)
+const int debug_flag = 1;
+const int kStorageBuilding = 256;
+}
 
 Simulator::Simulator(WorldState& world, TaskTree& tree, Scheduler& scheduler, std::vector<Agent*>& agents)
-: world_(world), tree_(tree), scheduler_(scheduler), agents_(agents) {
+: world_(world), tree_(tree), scheduler_(scheduler), agents_(agents), rng_(114514),
+  replan_min_interval_(10), replan_full_interval_(100), last_replan_tick_(-1000000),
+  last_full_replan_tick_(-1000000), replan_pending_(false) {
 	current_task_.assign(agents_.size(), -1);
 	ticks_left_.assign(agents_.size(), 0);
 	harvested_since_leave_.assign(agents_.size(), 0);
 	current_batch_.assign(agents_.size(), 0);
+	replan_affected_.assign(agents_.size(), 0);
+	harvest_rp_.assign(agents_.size(), -1);
+	slots_.reset(world_.getResourcePoints(), 1);
+	slots_.resizeAgents(agents_.size());
+	const Building* storage = world_.getBuilding(kStorageBuilding);
+	if (storage && storage->isCompleted) storage_sites_.push_back(std::make_pair(storage->x, storage->y));
+}
+
+void Simulator::setCarryCapacity(int capacity) {
+	carry_capacity_ = std::max(0, capacity);
+	for (size_t aid = 0; aid < agents_.size(); ++aid) agents_[aid]->inventory.capacity = carry_capacity_;
+}
+
+void Simulator::setReplanInterval(int min_interval, int full_interval) {
+	replan_min_interval_ = std::max(1, min_interval);
+	replan_full_interval_ = std::max(replan_min_interval_, full_interval);
+}
+
+void Simulator::setIdle(size_t aid) {
+	current_task_[aid] = -1;
+	replan_affected_[aid] = 1;
+	replan_pending_ = true;
+	noteTaskChange(aid);
+}
+
+void Simulator::noteTaskChange(size_t aid) {
+	releaseResourcePoint(aid);
+	// 开始采集即预留资源点，后开工的 agent 直接去其他空位而不是挤到同一处等待
+	if (current_task_[aid] >= 0 && tree_.get(current_task_[aid]).type == TaskType::Gather) {
+		int dist = 0;
+		targetResourcePoint(aid, tree_.get(current_task_[aid]).item_id, dist);
+	}
+	if (coroutine_agents_) respawn_.push_back(aid);
+}
+
+void Simulator::markGatherers(int item_id) {
+	for (size_t aid = 0; aid < current_task_.size(); ++aid) {
+		if (current_task_[aid] == -1) continue;
+		const TFNode& n = tree_.get(current_task_[aid]);
+		if (n.type != TaskType::Gather) continue;
+		if (item_id >= 0 && n.item_id != item_id) continue;
+		replan_affected_[aid] = 1;
+	}
+	replan_pending_ = true;
+}
+
+void Simulator::noteShortageChanges(const std::map<int, int>& shortage) {
+	// 只关心缺口“跨零”：从无到有（空闲者可接新活）或从有到无（相关采集者应释放）
+	std::map<int, int>::const_iterator a = last_shortage_.begin();
+	std::map<int, int>::const_iterator b = shortage.begin();
+	while (a != last_shortage_.end() || b != shortage.end()) {
+		int item_id;
+		bool was = false, now = false;
+		if (b == shortage.end() || (a != last_shortage_.end() && a->first < b->first)) {
+			item_id = a->first; was = a->second > 0; ++a;
+		} else if (a == last_shortage_.end() || b->first < a->first) {
+			item_id = b->first; now = b->second > 0; ++b;
+		} else {
+			item_id = a->first; was = a->second > 0; now = b->second > 0; ++a; ++b;
+		}
+		if (was == now) continue;
+		replan_pending_ = true;
+		if (!now) markGatherers(item_id);
+	}
+	last_shortage_ = shortage;
 }
 
 void Simulator::run(int ticks) {
-	std::ofstream log("Simulation.log");
-	if (!log.is_open()) {
-		std::cerr << "Failed to open Simulation.log for writing" << std::endl;
-		return;
+	if (!begin()) return;
+	step(ticks);
+	finish();
+}
+
+bool Simulator::begin() {
+	tick_ = 0;
+	if (log_path_.empty()) return true;
+	log_.open(log_path_.c_str());
+	if (!log_.is_open()) {
+		std::cerr << "Failed to open " << log_path_ << " for writing" << std::endl;
+		return false;
 	}
-	std::mt19937 rng(114514);
-	// debug_flag: 0 = no debug; 1 = basic (shortage/needs/tasks for visualizer); 2 = verbose (ready/blocked/assign)
-	const int debug_flag = 1;
 
-	log << "ResourcePoints:" << std::endl;
+	log_ << "ResourcePoints:" << std::endl;
 	for (std::map<int, ResourcePoint>::const_iterator it = world_.getResourcePoints().begin(); it != world_.getResourcePoints().end(); ++it) {
-		log << "RP " << it->first << " item " << it->second.resource_item_id
-		    << " at (" << it->second.x << "," << it->second.y << ")" << std::endl;
+		log_ << "RP " << it->first << " item " << it->second.resource_item_id
+		     << " at (" << it->second.x << "," << it->second.y << ")" << std::endl;
 	}
-	log << "Buildings:" << std::endl;
+	log_ << "Buildings:" << std::endl;
 	for (std::map<int, Building>::const_iterator it = world_.getBuildings().begin(); it != world_.getBuildings().end(); ++it) {
-		log << "B " << it->first << " " << it->second.building_name
-		    << " at (" << it->second.x << "," << it->second.y << ")" << std::endl;
+		log_ << "B " << it->first << " " << it->second.building_name
+		     << " at (" << it->second.x << "," << it->second.y << ")" << std::endl;
 	}
+	return true;
+}
+
+void Simulator::syncAgentSlots() {
+	// 新追加的 agent：空闲、无计时，并触发一次事件重规划
+	size_t old = current_task_.size();
+	if (agents_.size() <= old) return;
+	current_task_.resize(agents_.size(), -1);
+	ticks_left_.resize(agents_.size(), 0);
+	harvested_since_leave_.resize(agents_.size(), 0);
+	current_batch_.resize(agents_.size(), 0);
+	replan_affected_.resize(agents_.size(), 1);
+	slots_.resizeAgents(agents_.size());
+	harvest_rp_.resize(agents_.size(), -1);
+	for (size_t aid = old; aid < agents_.size(); ++aid) agents_[aid]->inventory.capacity = carry_capacity_;
+	behaviors_.resize(agents_.size());
+	replan_pending_ = true;
+}
 
-	for (int t = 0; t < ticks; ++t) {
-		bool do_replan = (t % 100 == 0); // 每 5 秒重分配一次
+void Simulator::step(int ticks) {
+	syncAgentSlots();
+	for (int k = 0; k < ticks; ++k, ++tick_) {
+		const int t = tick_;
+		world_.setTick(t);
+		int refilled = -1;
+		while (world_.popRefilled(refilled)) markGatherers(refilled); // 枯竭的资源点再生，采集者复查
 		tree_.syncWithWorld(world_);
+		if (coroutine_agents_) {
+			// 上一 tick 以来的库存/建筑变化唤醒等待它们的协程
+			for (std::set<int>::const_iterator it = world_.dirtyItems().begin(); it != world_.dirtyItems().end(); ++it) {
+				behaviors_.signal(EventKey{EventKind::Item, *it}, t);
+			}
+			for (std::set<int>::const_iterator it = world_.dirtyBuildings().begin(); it != world_.dirtyBuildings().end(); ++it) {
+				behaviors_.signal(EventKey{EventKind::Building, *it}, t);
+			}
+		}
+		world_.clearDirty();
 		std::map<int, int> shortage = scheduler_.computeShortage(tree_, world_);
-		if (do_replan && debug_flag >= 1) {
-			// 调试：输出当前缺口
-			log << "[Tick " << t << "] Shortage:";
-			for (std::map<int,int>::const_iterator it = shortage.begin(); it != shortage.end(); ++it) {
-				log << " I" << it->first << ":" << it->second;
+		noteShortageChanges(shortage);
+		// 兜底全量重规划（默认每 5 秒），其余时间由事件触发、且受最小间隔限制
+		bool full = (t - last_full_replan_tick_ >= replan_full_interval_);
+		bool triggered = replan_pending_ && (t - last_replan_tick_ >= replan_min_interval_);
+		if (job_ && (t - job_->tick >= async_max_lag_
+		             || job_done_.wait_for(std::chrono::seconds(0)) == std::future_status::ready)) {
+			collectReplan(t, shortage);
+		}
+		if ((full || triggered) && !job_) {
+			replan(t, shortage, full);
+		}
+		execute(t);
+		drainEvents(t);
+		logTick(t);
+	}
+}
+
+void Simulator::finish() {
+	if (job_) { // 结束时仍在计算的计划直接丢弃
+		job_done_.wait();
+		job_.reset();
+	}
+	if (async_replan_) {
+		const ReplanStats& st = replan_stats_;
+		log_ << "[Async] plans=" << st.plans
+		     << " staleness_avg=" << (st.plans > 0 ? static_cast<double>(st.staleness_sum) / st.plans : 0.0)
+		     << " staleness_max=" << st.staleness_max
+		     << " accepted=" << st.accepted << " rejected=" << st.rejected << std::endl;
+	}
+	if (coroutine_agents_) {
+		const BehaviorStats& st = behaviors_.stats();
+		log_ << "[Coroutines] started=" << st.started << " resumes=" << st.resumes
+		     << " timer_wakes=" << st.timer_wakes << " event_wakes=" << st.event_wakes
+		     << " frames=" << behaviors_.framePool().allocations()
+		     << " slabs=" << behaviors_.framePool().slabs() << std::endl;
+	}
+	if (carry_capacity_ > 0) {
+		log_ << "[Haul] trips=" << haul_stats_.trips << " items=" << haul_stats_.items
+		     << " to_consumer=" << haul_stats_.to_consumer << std::endl;
+	}
+	log_ << "[Slots] reservations=" << slot_stats_.reservations << " redirects=" << slot_stats_.redirects
+	     << " wait_ticks=" << slot_stats_.wait_ticks << std::endl;
+	if (log_.is_open()) log_.close();
+}
+
+void Simulator::emit(int t, int type, size_t aid, int target_id, int quantity) {
+	if (!on_event_) return;
+	SimEvent ev = {t, type, static_cast<int>(aid), target_id, quantity};
+	on_event_(ev);
+}
+
+void Simulator::launchReplan(int t, const std::map<int, int>& shortage, bool full, const std::vector<int>& ready) {
+	// 在主线程拷贝快照，后台线程只读写自己的副本
+	job_.reset(new ReplanJob(world_, tree_));
+	ReplanJob* job = job_.get();
+	job->tick = t;
+	job->full = full;
+	job->agents.reserve(agents_.size());
+	for (size_t i = 0; i < agents_.size(); ++i) job->agents.push_back(*agents_[i]);
+	for (size_t i = 0; i < job->agents.size(); ++i) job->agent_ptrs.push_back(&job->agents[i]);
+	job->current_task = current_task_;
+	job->ready = ready;
+	job->shortage = shortage;
+	job_done_ = std::async(std::launch::async, [job]() {
+		Scheduler scheduler(job->world);
+		job->plan = scheduler.assign(job->tree, job->ready, job->agent_ptrs, job->shortage,
+		                             job->current_task, job->current_task, job->tick);
+	});
+}
+
+void Simulator::collectReplan(int t, const std::map<int, int>& shortage) {
+	job_done_.get();
+	std::unique_ptr<ReplanJob> job(job_.release());
+	int staleness = t - job->tick;
+	replan_stats_.plans += 1;
+	replan_stats_.staleness_sum += staleness;
+	replan_stats_.staleness_max = std::max(replan_stats_.staleness_max, staleness);
+
+	// 校验：任务仍 ready 且有剩余需求、agent 仍空闲、材料仍够（扣除尚未开工的在制任务与已接受的计划）
+	std::vector<int> ready = tree_.ready(world_);
+	std::set<int> ready_set(ready.begin(), ready.end());
+	std::map<int, int> available;
+	for (std::map<int, Item>::const_iterator it = world_.getItems().begin(); it != world_.getItems().end(); ++it) {
+		available[it->first] = it->second.quantity;
+	}
+	auto materialsOf = [&](const TFNode& n) {
+		std::vector<std::pair<int,int> > mats;
+		if (n.type == TaskType::Craft) {
+			const CraftingRecipe* r = world_.getCraftingSystem().getRecipe(n.crafting_id);
+			if (r) {
+				for (size_t mi = 0; mi < r->materials.size(); ++mi) {
+					mats.push_back(std::make_pair(r->materials[mi].item_id, r->materials[mi].quantity_required));
+				}
+			}
+		} else if (n.type == TaskType::Build) {
+			const Building* b = world_.getBuilding(n.building_id);
+			if (b) mats = b->required_materials;
+		}
+		return mats;
+	};
+	for (size_t aid = 0; aid < current_task_.size(); ++aid) {
+		if (current_task_[aid] == -1 || ticks_left_[aid] != 0) continue;
+		std::vector<std::pair<int,int> > mats = materialsOf(tree_.get(current_task_[aid]));
+		for (size_t mi = 0; mi < mats.size(); ++mi) available[mats[mi].first] -= mats[mi].second;
+	}
+	std::vector<std::pair<int,int> > accepted;
+	for (size_t i = 0; i < job->plan.size(); ++i) {
+		int tid = job->plan[i].first;
+		int aid = job->plan[i].second;
+		bool ok = aid >= 0 && aid < static_cast<int>(current_task_.size()) && current_task_[aid] == -1
+		          && tid >= 0 && tid < static_cast<int>(tree_.nodes().size())
+		          && ready_set.count(tid) && tree_.remainingNeed(tree_.get(tid), world_) > 0;
+		std::vector<std::pair<int,int> > mats;
+		if (ok) {
+			mats = materialsOf(tree_.get(tid));
+			for (size_t mi = 0; mi < mats.size() && ok; ++mi) {
+				if (available[mats[mi].first] < mats[mi].second) ok = false;
 			}
-			log << std::endl;
+		}
+		if (!ok) {
+			replan_stats_.rejected += 1;
+			log_ << "[Tick " << t << "] Reject stale task " << tid << " -> Agent " << aid
+			     << " (planned at tick " << job->tick << ")" << std::endl;
+			continue;
+		}
+		for (size_t mi = 0; mi < mats.size(); ++mi) available[mats[mi].first] -= mats[mi].second;
+		replan_stats_.accepted += 1;
+		accepted.push_back(job->plan[i]);
+	}
+	applyPlan(t, accepted, shortage, job->full);
+}
 
-			// 释放所有未被执行的采集任务的锁定，避免历史分配把需求“锁死”
-			std::set<int> in_use;
-			for (size_t i = 0; i < current_task_.size(); ++i) {
-				if (current_task_[i] != -1) in_use.insert(current_task_[i]);
+void Simulator::replan(int t, const std::map<int, int>& shortage, bool full) {
+	std::vector<int> ready = prepareReplan(t, shortage, full);
+	if (async_replan_) {
+		launchReplan(t, shortage, full, ready);
+		return;
+	}
+	std::vector<std::pair<int,int> > plan = scheduler_.assign(tree_, ready, agents_, shortage, current_task_, current_task_, t);
+	applyPlan(t, plan, shortage, full);
+	// 限时竞价到期：剩下的任务在下一次允许重规划时接着分配
+	if (scheduler_.anytimeStats().last_truncated) replan_pending_ = true;
+}
+
+std::vector<int> Simulator::prepareReplan(int t, const std::map<int, int>& shortage, bool full) {
+	last_replan_tick_ = t;
+	if (full) last_full_replan_tick_ = t;
+	replan_pending_ = false; // 之后新到的事件会重新置位
+
+	if (debug_flag >= 1) {
+		// 调试：输出当前缺口
+		log_ << "[Tick " << t << "] Shortage:";
+		for (std::map<int,int>::const_iterator it = shortage.begin(); it != shortage.end(); ++it) {
+			log_ << " I" << it->first << ":" << it->second;
+		}
+		log_ << std::endl;
+	}
+
+	if (full) {
+		// 释放所有未被执行的采集任务的锁定，避免历史分配把需求“锁死”
+		std::set<int> in_use;
+		for (size_t i = 0; i < current_task_.size(); ++i) {
+			if (current_task_[i] != -1) in_use.insert(current_task_[i]);
+		}
+		for (size_t i = 0; i < tree_.nodes().size(); ++i) {
+			TFNode& n = tree_.get(static_cast<int>(i));
+			if (n.type == TaskType::Gather && in_use.find(static_cast<int>(i)) == in_use.end()) {
+				n.allocated = 0;
 			}
-			for (size_t i = 0; i < tree_.nodes().size(); ++i) {
-				TFNode& n = tree_.get(static_cast<int>(i));
-				if (n.type == TaskType::Gather && in_use.find(static_cast<int>(i)) == in_use.end()) {
-					n.allocated = 0;
+		}
+	}
+
+	// 根据缺口和估价决定是否中断采集任务；事件重规划只复查受影响的 agent
+	std::vector<int> ready = tree_.ready(world_);
+	for (size_t aid = 0; aid < current_task_.size(); ++aid) {
+		if (current_task_[aid] == -1) continue;
+		if (!full && !replan_affected_[aid]) continue;
+		const TFNode& n = tree_.get(current_task_[aid]);
+		if (n.type == TaskType::Gather) {
+			std::map<int,int>::const_iterator itNeed = shortage.find(n.item_id);
+			// 缺口不计本节点自己的锁定：否则余量小于一批时，开工的锁定本身就会让缺口“补足”而被立即中断
+			int open = (itNeed == shortage.end() ? 0 : itNeed->second) - tree_.remainingNeed(n, world_) + tree_.remainingNeedRaw(n, world_);
+			if (open <= 0) {
+				current_task_[aid] = -1;
+				ticks_left_[aid] = 0;
+				harvested_since_leave_[aid] = 0;
+				current_batch_[aid] = 0;
+				tree_.get(n.id).allocated = 0;
+				noteTaskChange(aid);
+				continue;
+			}
+			// 计算当前采集任务的得分，用于与新任务比较
+			double self_score = scheduler_.publicScore(n, *agents_[aid], shortage, &tree_.meta(n.id));
+			bool should_interrupt = false;
+			for (size_t j = 0; j < ready.size(); ++j) {
+				const TFNode& cand = tree_.get(ready[j]);
+				double cand_score = scheduler_.publicScore(cand, *agents_[aid], shortage, &tree_.meta(ready[j]));
+				if (cand_score > self_score + 1e-6) { // 更高优任务，允许中断
+					should_interrupt = true;
+					break;
 				}
 			}
+			if (should_interrupt) {
+				current_task_[aid] = -1;
+				ticks_left_[aid] = 0;
+				harvested_since_leave_[aid] = 0;
+				current_batch_[aid] = 0;
+				tree_.get(n.id).allocated = 0;
+				noteTaskChange(aid);
+			}
+		}
+	}
+	if (debug_flag >= 2) {
+		log_ << "[Tick " << t << "] Ready:";
+		for (size_t i = 0; i < ready.size(); ++i) {
+			const TFNode& n = tree_.get(ready[i]);
+			int need = tree_.remainingNeed(n, world_);
+			log_ << " #" << ready[i] << "("
+			     << (n.type == TaskType::Build ? "B" : (n.type == TaskType::Craft ? "C" : "G"))
+			     << "," << n.item_id << ",need=" << need << ")";
+		}
+		log_ << std::endl;
 
-			// 根据缺口和估价决定是否中断采集任务
-			for (size_t aid = 0; aid < current_task_.size(); ++aid) {
-				if (current_task_[aid] == -1) continue;
-				const TFNode& n = tree_.get(current_task_[aid]);
-				if (n.type == TaskType::Gather) {
-					std::map<int,int>::const_iterator itNeed = shortage.find(n.item_id);
-					if (itNeed == shortage.end() || itNeed->second <= 0) {
-						current_task_[aid] = -1;
-						ticks_left_[aid] = 0;
-						harvested_since_leave_[aid] = 0;
-						current_batch_[aid] = 0;
-						tree_.get(n.id).allocated = 0;
-						continue;
-					}
-					// 计算当前采集任务的得分，用于与新任务比较
-					double self_score = scheduler_.publicScore(n, *agents_[aid], shortage);
-					bool should_interrupt = false;
-					std::vector<int> ready = tree_.ready(world_);
-					for (size_t j = 0; j < ready.size(); ++j) {
-						const TFNode& cand = tree_.get(ready[j]);
-						double cand_score = scheduler_.publicScore(cand, *agents_[aid], shortage);
-						if (cand_score > self_score + 1e-6) { // 更高优任务，允许中断
-							should_interrupt = true;
-							break;
-						}
-					}
-					if (should_interrupt) {
-						current_task_[aid] = -1;
-						ticks_left_[aid] = 0;
-						harvested_since_leave_[aid] = 0;
-						current_batch_[aid] = 0;
-						tree_.get(n.id).allocated = 0;
-					}
-				}
+		// 调试：输出未完成但未 ready 的节点及其未完成子节点
+		int blocked_cnt = 0;
+		for (size_t i = 0; i < tree_.nodes().size(); ++i) {
+			const TFNode& n = tree_.nodes()[i];
+			int raw_need = tree_.remainingNeedRaw(n, world_);
+			if (raw_need <= 0) continue;
+			bool already_ready = false;
+			for (size_t r = 0; r < ready.size(); ++r) {
+				if (ready[r] == static_cast<int>(i)) { already_ready = true; break; }
 			}
-			std::vector<int> ready = tree_.ready(world_);
-			if (debug_flag >= 2) {
-				log << "[Tick " << t << "] Ready:";
-				for (size_t i = 0; i < ready.size(); ++i) {
-					const TFNode& n = tree_.get(ready[i]);
-					int need = tree_.remainingNeed(n, world_);
-					log << " #" << ready[i] << "("
-					    << (n.type == TaskType::Build ? "B" : (n.type == TaskType::Craft ? "C" : "G"))
-					    << "," << n.item_id << ",need=" << need << ")";
-				}
-				log << std::endl;
-
-				// 调试：输出未完成但未 ready 的节点及其未完成子节点
-				int blocked_cnt = 0;
-				for (size_t i = 0; i < tree_.nodes().size(); ++i) {
-					const TFNode& n = tree_.nodes()[i];
-					int raw_need = tree_.remainingNeedRaw(n, world_);
-					if (raw_need <= 0) continue;
-					bool already_ready = false;
-					for (size_t r = 0; r < ready.size(); ++r) {
-						if (ready[r] == static_cast<int>(i)) { already_ready = true; break; }
-					}
-					if (already_ready) continue;
-					log << "[Tick " << t << "] Blocked #" << i << "("
-					    << (n.type == TaskType::Build ? "B" : (n.type == TaskType::Craft ? "C" : "G"))
-					    << "," << n.item_id << ",need=" << raw_need << ") children:";
-					int printed = 0;
-					for (size_t c = 0; c < n.children.size(); ++c) {
-						const TFNode& ch = tree_.get(n.children[c]);
-						int child_need = tree_.remainingNeedRaw(ch, world_);
-						if (child_need > 0) {
-							log << " #" << ch.id << "(need=" << child_need << ")";
-							if (++printed >= 4) break;
-						}
-					}
-					log << std::endl;
-					if (++blocked_cnt >= 20) break; // 防止日志爆炸
+			if (already_ready) continue;
+			log_ << "[Tick " << t << "] Blocked #" << i << "("
+			     << (n.type == TaskType::Build ? "B" : (n.type == TaskType::Craft ? "C" : "G"))
+			     << "," << n.item_id << ",need=" << raw_need << ") children:";
+			int printed = 0;
+			NodeRange kids = tree_.children(static_cast<int>(i));
+			for (size_t c = 0; c < kids.size(); ++c) {
+				const TFNode& ch = tree_.get(kids[c]);
+				int child_need = tree_.remainingNeedRaw(ch, world_);
+				if (child_need > 0) {
+					log_ << " #" << ch.id << "(need=" << child_need << ")";
+					if (++printed >= 4) break;
 				}
 			}
+			log_ << std::endl;
+			if (++blocked_cnt >= 20) break; // 防止日志爆炸
+		}
+	}
 
-			std::vector<std::pair<int,int> > plan = scheduler_.assign(tree_, ready, agents_, shortage, current_task_, current_task_, t);
-			// 将分配结果加入各自 bundle
-			for (size_t i = 0; i < plan.size(); ++i) {
-				int aid = plan[i].second;
-				if (aid < 0 || aid >= static_cast<int>(current_task_.size())) continue;
-				int tid = plan[i].first;
-				// 避免重复插入
-				if (std::find(agents_[aid]->bundle.begin(), agents_[aid]->bundle.end(), tid) != agents_[aid]->bundle.end()) continue;
-				const TFNode& n = tree_.get(tid);
-				int batch = 1;
-				if (n.type == TaskType::Gather) batch = 10;
-				else if (n.type == TaskType::Craft) {
-					const CraftingRecipe* r = world_.getCraftingSystem().getRecipe(n.crafting_id);
-					if (r && r->quantity_produced > 0) batch = r->quantity_produced;
-				}
-				tree_.get(tid).allocated += batch; // 锁定一批
-				agents_[aid]->bundle.push_back(tid);
-				log << "[Tick " << t << "] Assign task " << tid << " -> Agent " << aid << " (queued)" << std::endl;
+	return ready;
+}
+
+void Simulator::applyPlan(int t, const std::vector<std::pair<int,int> >& plan, const std::map<int, int>& shortage, bool full) {
+	// 将分配结果加入各自 bundle
+	for (size_t i = 0; i < plan.size(); ++i) {
+		int aid = plan[i].second;
+		if (aid < 0 || aid >= static_cast<int>(current_task_.size())) continue;
+		int tid = plan[i].first;
+		if (tree_.isFreed(tid)) continue; // 异步规划期间该子树已被释放
+		// 避免重复插入
+		if (std::find(agents_[aid]->bundle.begin(), agents_[aid]->bundle.end(), tid) != agents_[aid]->bundle.end()) continue;
+		const TFNode& n = tree_.get(tid);
+		int batch = 1;
+		if (n.type == TaskType::Gather) batch = 10;
+		else if (n.type == TaskType::Craft) {
+			const CraftingRecipe* r = world_.getCraftingSystem().getRecipe(n.crafting_id);
+			if (r && r->quantity_produced > 0) batch = r->quantity_produced;
+		}
+		tree_.get(tid).allocated += batch; // 锁定一批
+		agents_[aid]->bundle.push_back(tid);
+		replan_affected_[aid] = 1;
+		log_ << "[Tick " << t << "] Assign task " << tid << " -> Agent " << aid << " (queued)" << std::endl;
+	}
+	// 按估值对每个 bundle 排序（高到低）；事件重规划只重排受影响/新入队的 bundle
+	for (size_t aid = 0; aid < agents_.size(); ++aid) {
+		std::vector<int>& b = agents_[aid]->bundle;
+		if (b.empty()) continue;
+		if (!full && !replan_affected_[aid]) continue;
+		std::sort(b.begin(), b.end(), [&](int a, int btid){
+			const TFNode& na = tree_.get(a);
+			const TFNode& nb = tree_.get(btid);
+			double sa = scheduler_.publicScore(na, *agents_[aid], shortage, &tree_.meta(a));
+			double sb = scheduler_.publicScore(nb, *agents_[aid], shortage, &tree_.meta(btid));
+			if (std::abs(sa - sb) < 1e-6) return a < btid;
+			return sa > sb;
+		});
+	}
+	// 将空闲的 agent 拉起 bundle 里的任务
+	for (size_t aid = 0; aid < agents_.size(); ++aid) {
+		if (current_task_[aid] != -1) continue;
+		std::vector<int>& b = agents_[aid]->bundle;
+		if (b.empty()) continue;
+		int tid = b.front();
+		b.erase(b.begin());
+		current_task_[aid] = tid;
+		ticks_left_[aid] = 0;
+		// 设置当前批量（锁定已在分配时处理）
+		const TFNode& n = tree_.get(tid);
+		int batch = 1;
+		if (n.type == TaskType::Gather) batch = 10;
+		else if (n.type == TaskType::Craft) {
+			const CraftingRecipe* r = world_.getCraftingSystem().getRecipe(n.crafting_id);
+			if (r && r->quantity_produced > 0) batch = r->quantity_produced;
+		}
+		current_batch_[aid] = batch;
+		noteTaskChange(aid);
+		log_ << "[Tick " << t << "] Start task " << tid << " -> Agent " << aid << std::endl;
+	}
+	// 空闲仍无任务的，尝试从他人 bundle 尾部拿一个最低优先级任务
+	for (size_t aid = 0; aid < agents_.size(); ++aid) {
+		if (current_task_[aid] != -1) continue;
+		if (!agents_[aid]->bundle.empty()) continue;
+		int donor = -1;
+		int donor_tid = -1;
+		for (size_t other = 0; other < agents_.size(); ++other) {
+			if (other == aid) continue;
+			std::vector<int>& ob = agents_[other]->bundle;
+			if (ob.size() <= 1) continue; // 保留至少一个
+			donor = static_cast<int>(other);
+			donor_tid = ob.back();
+			ob.pop_back();
+			break;
+		}
+		if (donor != -1 && donor_tid != -1) {
+			// 避免重复
+			if (std::find(agents_[aid]->bundle.begin(), agents_[aid]->bundle.end(), donor_tid) == agents_[aid]->bundle.end()) {
+				agents_[aid]->bundle.push_back(donor_tid);
 			}
-			// 按估值对每个 bundle 排序（高到低）
-			for (size_t aid = 0; aid < agents_.size(); ++aid) {
-				std::vector<int>& b = agents_[aid]->bundle;
-				if (b.empty()) continue;
-				std::sort(b.begin(), b.end(), [&](int a, int btid){
-					const TFNode& na = tree_.get(a);
-					const TFNode& nb = tree_.get(btid);
-					double sa = scheduler_.publicScore(na, *agents_[aid], shortage);
-					double sb = scheduler_.publicScore(nb, *agents_[aid], shortage);
-					if (std::abs(sa - sb) < 1e-6) return a < btid;
-					return sa > sb;
-				});
+			log_ << "[Tick " << t << "] Steal lowest task " << donor_tid << " from Agent " << donor << " -> Agent " << aid << std::endl;
+			// 立即开始执行
+			current_task_[aid] = donor_tid;
+			ticks_left_[aid] = 0;
+			const TFNode& n = tree_.get(donor_tid);
+			int batch = 1;
+			if (n.type == TaskType::Gather) batch = 10;
+			else if (n.type == TaskType::Craft) {
+				const CraftingRecipe* r = world_.getCraftingSystem().getRecipe(n.crafting_id);
+				if (r && r->quantity_produced > 0) batch = r->quantity_produced;
 			}
-			// 将空闲的 agent 拉起 bundle 里的任务
-			for (size_t aid = 0; aid < agents_.size(); ++aid) {
-				if (current_task_[aid] != -1) continue;
-				std::vector<int>& b = agents_[aid]->bundle;
-				if (b.empty()) continue;
-				int tid = b.front();
-				b.erase(b.begin());
-				current_task_[aid] = tid;
-				ticks_left_[aid] = 0;
-				// 设置当前批量（锁定已在分配时处理）
-				const TFNode& n = tree_.get(tid);
-				int batch = 1;
-				if (n.type == TaskType::Gather) batch = 10;
-				else if (n.type == TaskType::Craft) {
-					const CraftingRecipe* r = world_.getCraftingSystem().getRecipe(n.crafting_id);
-					if (r && r->quantity_produced > 0) batch = r->quantity_produced;
-				}
-				current_batch_[aid] = batch;
-				log << "[Tick " << t << "] Start task " << tid << " -> Agent " << aid << std::endl;
+			current_batch_[aid] = batch;
+			noteTaskChange(aid);
+			// 弹出刚开始执行的这个任务
+			std::vector<int>& b = agents_[aid]->bundle;
+			for (std::vector<int>::iterator it = b.begin(); it != b.end(); ++it) {
+				if (*it == donor_tid) { b.erase(it); break; }
 			}
-			// 空闲仍无任务的，尝试从他人 bundle 尾部拿一个最低优先级任务
-			for (size_t aid = 0; aid < agents_.size(); ++aid) {
-				if (current_task_[aid] != -1) continue;
-				if (!agents_[aid]->bundle.empty()) continue;
-				int donor = -1;
-				int donor_tid = -1;
-				for (size_t other = 0; other < agents_.size(); ++other) {
-					if (other == aid) continue;
-					std::vector<int>& ob = agents_[other]->bundle;
-					if (ob.size() <= 1) continue; // 保留至少一个
-					donor = static_cast<int>(other);
-					donor_tid = ob.back();
-					ob.pop_back();
-					break;
-				}
-				if (donor != -1 && donor_tid != -1) {
-					// 避免重复
-					if (std::find(agents_[aid]->bundle.begin(), agents_[aid]->bundle.end(), donor_tid) == agents_[aid]->bundle.end()) {
-						agents_[aid]->bundle.push_back(donor_tid);
-					}
-					log << "[Tick " << t << "] Steal lowest task " << donor_tid << " from Agent " << donor << " -> Agent " << aid << std::endl;
-					// 立即开始执行
-					current_task_[aid] = donor_tid;
-					ticks_left_[aid] = 0;
-					const TFNode& n = tree_.get(donor_tid);
-					int batch = 1;
-					if (n.type == TaskType::Gather) batch = 10;
-					else if (n.type == TaskType::Craft) {
-						const CraftingRecipe* r = world_.getCraftingSystem().getRecipe(n.crafting_id);
-						if (r && r->quantity_produced > 0) batch = r->quantity_produced;
-					}
-					current_batch_[aid] = batch;
-					// 弹出刚开始执行的这个任务
-					std::vector<int>& b = agents_[aid]->bundle;
-					for (std::vector<int>::iterator it = b.begin(); it != b.end(); ++it) {
-						if (*it == donor_tid) { b.erase(it); break; }
-					}
-					log << "[Tick " << t << "] Start task " << donor_tid << " -> Agent " << aid << " (stolen)" << std::endl;
+			log_ << "[Tick " << t << "] Start task " << donor_tid << " -> Agent " << aid << " (stolen)" << std::endl;
+		}
+	}
+	replan_affected_.assign(agents_.size(), 0);
+	if (!full) return; // 交易只在兜底全量重规划时做，事件重规划不扰动他人 bundle
+
+	// 交易：分配后做一轮 bundle 尾部和随机任务的交换
+	const SchedulerPolicy& policy = scheduler_.policy();
+	auto scoreTaskFor = [&](int aid, int tid) -> double {
+		const TFNode& n = tree_.get(tid);
+		return scheduler_.publicScore(n, *agents_[aid], shortage, &tree_.meta(n.id));
+	};
+	auto resortBundle = [&](int aid) {
+		std::vector<int>& b = agents_[aid]->bundle;
+		if (b.empty()) return;
+		std::sort(b.begin(), b.end(), [&](int a, int btid){
+			double sa = scoreTaskFor(aid, a);
+			double sb = scoreTaskFor(aid, btid);
+			if (std::abs(sa - sb) < 1e-6) return a < btid;
+			return sa > sb;
+		});
+	};
+	auto attemptMove = [&](int from, int to, int tid, int current_tick) -> bool {
+		if (from == to) return false;
+		// 目的 bundle 已有则跳过
+		if (std::find(agents_[to]->bundle.begin(), agents_[to]->bundle.end(), tid) != agents_[to]->bundle.end()) return false;
+		double s_from = scoreTaskFor(from, tid);
+		double s_to = scoreTaskFor(to, tid);
+		if (s_to <= s_from + policy.trade_min_gain) return false; // 最小增益门槛
+		std::vector<int>& bf = agents_[from]->bundle;
+		std::vector<int>& bt = agents_[to]->bundle;
+		size_t size_from_before = bf.size();
+		size_t size_to_before = bt.size();
+		// 从 from 移除
+		for (std::vector<int>::iterator it = bf.begin(); it != bf.end(); ++it) {
+			if (*it == tid) { bf.erase(it); break; }
+		}
+		bt.push_back(tid);
+		// 退火/计数：增加 trade_count，记录 last_trade_tick
+		TFNodeMeta& m = tree_.meta(tid);
+		m.trade_count += 1;
+		m.last_trade_tick = current_tick;
+		resortBundle(from);
+		resortBundle(to);
+		double gain = s_to - s_from;
+		log_ << "[Tick " << t << "] Trade task " << tid << " from Agent " << from << " -> Agent " << to
+		     << " gain=" << gain
+		     << " bundle " << size_from_before << "->" << bf.size()
+		     << " / " << size_to_before << "->" << bt.size() << std::endl;
+		return true;
+	};
+
+	// 尾部 3 个任务尝试交出去
+	for (size_t aid = 0; aid < agents_.size(); ++aid) {
+		std::vector<int>& b = agents_[aid]->bundle;
+		if (b.empty()) continue;
+		int take = std::min<int>(3, static_cast<int>(b.size()));
+		for (int k = 0; k < take; ++k) {
+			int tid = b[b.size() - 1 - k];
+			// 简单退火：如果本轮距离上次交易太近，跳过
+			if (t - tree_.meta(tid).last_trade_tick < policy.trade_cooldown) continue;
+			int best_to = -1;
+			double best_gain = 0.0;
+			double s_from = scoreTaskFor(aid, tid);
+			for (size_t other = 0; other < agents_.size(); ++other) {
+				if (other == aid) continue;
+				double s_to = scoreTaskFor(static_cast<int>(other), tid);
+				double gain = s_to - s_from;
+				if (gain > best_gain + 1e-6) {
+					best_gain = gain;
+					best_to = static_cast<int>(other);
 				}
 			}
-			// 交易：分配后做一轮 bundle 尾部和随机任务的交换
-			auto scoreTaskFor = [&](int aid, int tid) -> double {
-				const TFNode& n = tree_.get(tid);
-				return scheduler_.publicScore(n, *agents_[aid], shortage);
-			};
-			auto resortBundle = [&](int aid) {
-				std::vector<int>& b = agents_[aid]->bundle;
-				if (b.empty()) return;
-				std::sort(b.begin(), b.end(), [&](int a, int btid){
-					double sa = scoreTaskFor(aid, a);
-					double sb = scoreTaskFor(aid, btid);
-					if (std::abs(sa - sb) < 1e-6) return a < btid;
-					return sa > sb;
-				});
-			};
-			auto attemptMove = [&](int from, int to, int tid, int current_tick) -> bool {
-				if (from == to) return false;
-				// 目的 bundle 已有则跳过
-				if (std::find(agents_[to]->bundle.begin(), agents_[to]->bundle.end(), tid) != agents_[to]->bundle.end()) return false;
-				double s_from = scoreTaskFor(from, tid);
-				double s_to = scoreTaskFor(to, tid);
-				if (s_to <= s_from + 50.0) return false; // 最小增益门槛
-				std::vector<int>& bf = agents_[from]->bundle;
-				std::vector<int>& bt = agents_[to]->bundle;
-				size_t size_from_before = bf.size();
-				size_t size_to_before = bt.size();
-				// 从 from 移除
-				for (std::vector<int>::iterator it = bf.begin(); it != bf.end(); ++it) {
-					if (*it == tid) { bf.erase(it); break; }
-				}
-				bt.push_back(tid);
-				// 退火/计数：增加 trade_count，记录 last_trade_tick
-				TFNode& n = tree_.get(tid);
-				n.trade_count += 1;
-				n.last_trade_tick = current_tick;
-				resortBundle(from);
-				resortBundle(to);
+			if (best_to != -1) {
+				attemptMove(static_cast<int>(aid), best_to, tid, t);
+			}
+		}
+	}
+
+	// 随机抽取 10 个任务尝试交易
+	std::vector<std::pair<int,int> > pool;
+	for (size_t aid = 0; aid < agents_.size(); ++aid) {
+		for (size_t k = 0; k < agents_[aid]->bundle.size(); ++k) {
+			pool.push_back(std::make_pair(static_cast<int>(aid), agents_[aid]->bundle[k]));
+		}
+	}
+	if (!pool.empty()) {
+		std::shuffle(pool.begin(), pool.end(), rng_);
+		int limit = std::min<int>(10, static_cast<int>(pool.size()));
+		for (int idx = 0; idx < limit; ++idx) {
+			int from = pool[idx].first;
+			int tid = pool[idx].second;
+			if (t - tree_.meta(tid).last_trade_tick < policy.trade_cooldown) continue;
+			// 找一个更高分的 agent
+			int best_to = -1;
+			double best_gain = 0.0;
+			double s_from = scoreTaskFor(from, tid);
+			for (size_t other = 0; other < agents_.size(); ++other) {
+				if (static_cast<int>(other) == from) continue;
+				double s_to = scoreTaskFor(static_cast<int>(other), tid);
 				double gain = s_to - s_from;
-				log << "[Tick " << t << "] Trade task " << tid << " from Agent " << from << " -> Agent " << to
-				    << " gain=" << gain
-				    << " bundle " << size_from_before << "->" << bf.size()
-				    << " / " << size_to_before << "->" << bt.size() << std::endl;
-				return true;
-			};
-
-			// 尾部 3 个任务尝试交出去
-			for (size_t aid = 0; aid < agents_.size(); ++aid) {
-				std::vector<int>& b = agents_[aid]->bundle;
-				if (b.empty()) continue;
-				int take = std::min<int>(3, static_cast<int>(b.size()));
-				for (int k = 0; k < take; ++k) {
-					int tid = b[b.size() - 1 - k];
-					TFNode& n = tree_.get(tid);
-					// 简单退火：如果本轮距离上次交易太近，跳过
-					if (t - n.last_trade_tick < 50) continue;
-					int best_to = -1;
-					double best_gain = 0.0;
-					double s_from = scoreTaskFor(aid, tid);
-					for (size_t other = 0; other < agents_.size(); ++other) {
-						if (other == aid) continue;
-						double s_to = scoreTaskFor(static_cast<int>(other), tid);
-						double gain = s_to - s_from;
-						if (gain > best_gain + 1e-6) {
-							best_gain = gain;
-							best_to = static_cast<int>(other);
-						}
-					}
-					if (best_to != -1) {
-						attemptMove(static_cast<int>(aid), best_to, tid, t);
-					}
+				if (gain > best_gain + 1e-6) {
+					best_gain = gain;
+					best_to = static_cast<int>(other);
 				}
 			}
+			if (best_to != -1) {
+				attemptMove(from, best_to, tid, t);
+			}
+		}
+	}
 
-			// 随机抽取 10 个任务尝试交易
-			std::vector<std::pair<int,int> > pool;
-			for (size_t aid = 0; aid < agents_.size(); ++aid) {
-				for (size_t k = 0; k < agents_[aid]->bundle.size(); ++k) {
-					pool.push_back(std::make_pair(static_cast<int>(aid), agents_[aid]->bundle[k]));
+	// 如果某个 agent 任务数超过 40，尾部 20 尝试交出去
+	for (size_t aid = 0; aid < agents_.size(); ++aid) {
+		std::vector<int>& b = agents_[aid]->bundle;
+		if (b.size() <= 40) continue;
+		int take = std::min<int>(20, static_cast<int>(b.size()));
+		for (int k = 0; k < take; ++k) {
+			int tid = b[b.size() - 1 - k];
+			if (t - tree_.meta(tid).last_trade_tick < policy.trade_cooldown) continue;
+			int best_to = -1;
+			double best_gain = 0.0;
+			double s_from = scoreTaskFor(static_cast<int>(aid), tid);
+			for (size_t other = 0; other < agents_.size(); ++other) {
+				if (static_cast<int>(other) == static_cast<int>(aid)) continue;
+				double s_to = scoreTaskFor(static_cast<int>(other), tid);
+				double gain = s_to - s_from;
+				if (gain > best_gain + 1e-6) {
+					best_gain = gain;
+					best_to = static_cast<int>(other);
 				}
 			}
-			if (!pool.empty()) {
-				std::shuffle(pool.begin(), pool.end(), rng);
-				int limit = std::min<int>(10, static_cast<int>(pool.size()));
-				for (int idx = 0; idx < limit; ++idx) {
-					int from = pool[idx].first;
-					int tid = pool[idx].second;
-					TFNode& n = tree_.get(tid);
-					if (t - n.last_trade_tick < 50) continue;
-					// 找一个更高分的 agent
-					int best_to = -1;
-					double best_gain = 0.0;
-					double s_from = scoreTaskFor(from, tid);
-					for (size_t other = 0; other < agents_.size(); ++other) {
-						if (static_cast<int>(other) == from) continue;
-						double s_to = scoreTaskFor(static_cast<int>(other), tid);
-						double gain = s_to - s_from;
-						if (gain > best_gain + 1e-6) {
-							best_gain = gain;
-							best_to = static_cast<int>(other);
-						}
-					}
-					if (best_to != -1) {
-						attemptMove(from, best_to, tid, t);
-					}
-				}
+			if (best_to != -1) {
+				attemptMove(static_cast<int>(aid), best_to, tid, t);
 			}
+		}
+	}
+}
 
-			// 如果某个 agent 任务数超过 40，尾部 20 尝试交出去
-			for (size_t aid = 0; aid < agents_.size(); ++aid) {
-				std::vector<int>& b = agents_[aid]->bundle;
-				if (b.size() <= 40) continue;
-				int take = std::min<int>(20, static_cast<int>(b.size()));
-				for (int k = 0; k < take; ++k) {
-					int tid = b[b.size() - 1 - k];
-					TFNode& n = tree_.get(tid);
-					if (t - n.last_trade_tick < 50) continue;
-					int best_to = -1;
-					double best_gain = 0.0;
-					double s_from = scoreTaskFor(static_cast<int>(aid), tid);
-					for (size_t other = 0; other < agents_.size(); ++other) {
-						if (static_cast<int>(other) == static_cast<int>(aid)) continue;
-						double s_to = scoreTaskFor(static_cast<int>(other), tid);
-						double gain = s_to - s_from;
-						if (gain > best_gain + 1e-6) {
-							best_gain = gain;
-							best_to = static_cast<int>(other);
-						}
-					}
-					if (best_to != -1) {
-						attemptMove(static_cast<int>(aid), best_to, tid, t);
-					}
-				}
+ResourcePoint* Simulator::targetResourcePoint(size_t aid, int item_id, int& dist) {
+	int held = slots_.heldBy(aid);
+	if (held >= 0) {
+		ResourcePoint* rp = world_.getResourcePoint(held);
+		if (rp && rp->resource_item_id == item_id && world_.resourceAvailable(*rp) > 0) {
+			dist = agents_[aid]->getDistanceTo(rp->x, rp->y);
+			return rp;
+		}
+		releaseResourcePoint(aid); // 换了物品或已枯竭
+	}
+	ResourcePoint* free_rp = nullptr;
+	ResourcePoint* any_rp = nullptr;
+	int free_dist = 1e9;
+	dist = 1e9;
+	const std::vector<int>& ids = slots_.pointsOf(item_id);
+	for (size_t i = 0; i < ids.size(); ++i) {
+		ResourcePoint* rp = world_.getResourcePoint(ids[i]);
+		if (!rp || world_.resourceAvailable(*rp) <= 0) continue;
+		int d = agents_[aid]->getDistanceTo(rp->x, rp->y);
+		if (d < dist) { dist = d; any_rp = rp; }
+		if (d < free_dist && slots_.hasFree(ids[i])) { free_dist = d; free_rp = rp; }
+	}
+	if (!free_rp) return any_rp; // 全部满员：去最近的等空位
+	if (free_rp != any_rp) slot_stats_.redirects++;
+	claimResourcePoint(aid, free_rp->resource_point_id);
+	dist = free_dist;
+	return free_rp;
+}
+
+void Simulator::execute(int t) {
+	if (coroutine_agents_) { executeCoroutines(t); return; }
+	// 按动作类型分桶：先集中移动，再集中结算采集，最后集中推进制作/建造计时
+	struct Traveller { size_t aid; int x, y; };
+	struct Harvester { size_t aid; ResourcePoint* rp; };
+	std::vector<Traveller> travellers;
+	std::vector<Harvester> harvesters;
+	std::vector<size_t> crafters;
+	std::vector<size_t> builders;
+	std::vector<size_t> haulers;
+	for (size_t aid = 0; aid < agents_.size(); ++aid) {
+		if (needsHaul(aid)) {
+			releaseResourcePoint(aid);
+			haulers.push_back(aid);
+			continue;
+		}
+		if (current_task_[aid] == -1) continue;
+		const TFNode& node = tree_.get(current_task_[aid]);
+		if (node.type == TaskType::Gather) {
+			int need = gatherNeed(aid, node);
+			if (need <= 0) { setIdle(aid); continue; }
+			int best_dist = 0;
+			ResourcePoint* best_rp = targetResourcePoint(aid, node.item_id, best_dist);
+			if (!best_rp) { setIdle(aid); continue; }
+			if (best_dist > 0) {
+				Traveller tr = {aid, best_rp->x, best_rp->y};
+				travellers.push_back(tr);
+				harvested_since_leave_[aid] = 0;
+				continue;
+			}
+			if (!claimResourcePoint(aid, best_rp->resource_point_id)) {
+				slot_stats_.wait_ticks++; // 满员，等空位（每 tick 重新找目标）
+				continue;
 			}
+			Harvester h = {aid, best_rp};
+			harvesters.push_back(h);
+		} else if (node.type == TaskType::Craft) {
+			crafters.push_back(aid);
+		} else { // Build
+			Building* b = world_.getBuilding(node.building_id);
+			if (!b || tree_.isCompleted(node.id, world_)) { setIdle(aid); continue; }
+			const std::pair<int,int>& site = tree_.meta(node.id).coord; // 订单的工地，同类建筑可有多处
+			if (agents_[aid]->getDistanceTo(site.first, site.second) > 0) {
+				Traveller tr = {aid, site.first, site.second};
+				travellers.push_back(tr);
+				continue;
+			}
+			builders.push_back(aid);
 		}
+	}
 
-		// execute
-		// execute
-		std::map<int,int> rp_owner; // resource_point_id -> agent_id
-		for (size_t aid = 0; aid < agents_.size(); ++aid) {
-			if (current_task_[aid] == -1) continue;
-			TFNode& node = tree_.get(current_task_[aid]);
-			if (node.type == TaskType::Gather) {
-				int need = tree_.remainingNeedRaw(node, world_);
-				if (need <= 0) { current_task_[aid] = -1; continue; }
-				// 实时缺口，用于批次结束后是否停止
-				std::map<int,int> live_shortage = scheduler_.computeShortage(tree_, world_);
-				ResourcePoint* best_rp = nullptr;
-				int best_dist = 1e9;
-				for (std::map<int, ResourcePoint>::iterator it = world_.getResourcePoints().begin(); it != world_.getResourcePoints().end(); ++it) {
-					if (it->second.resource_item_id != node.item_id || it->second.remaining_resource <= 0) continue;
-					int d = agents_[aid]->getDistanceTo(it->second.x, it->second.y);
-					if (d < best_dist) { best_dist = d; best_rp = &(it->second); }
-				}
-				if (!best_rp) { current_task_[aid] = -1; continue; }
-				if (best_dist > 0) {
-					agents_[aid]->moveStep(best_rp->x, best_rp->y);
-					harvested_since_leave_[aid] = 0;
-					continue;
-				}
-				// at resource point: check occupancy
-				if (rp_owner.count(best_rp->resource_point_id) && rp_owner[best_rp->resource_point_id] != static_cast<int>(aid)) {
-					// occupied by others, wait
-					continue;
-				}
-				rp_owner[best_rp->resource_point_id] = static_cast<int>(aid);
-				if (ticks_left_[aid] == 0) ticks_left_[aid] = 20; // 1s = 20 ticks
-				ticks_left_[aid]--;
-				if (ticks_left_[aid] == 0) {
-					int harvest = std::min(10, std::min(need, best_rp->remaining_resource));
-					if (harvest > 0) {
-						best_rp->remaining_resource -= harvest;
-						world_.addItem(node.item_id, harvest);
-						node.produced += harvest;
-						harvested_since_leave_[aid] += harvest;
-					}
-					if (node.allocated > 0) node.allocated = std::max(0, node.allocated - harvest);
-					// 如果全局缺口已补足，立即停止采集
-					live_shortage = scheduler_.computeShortage(tree_, world_);
-					if (live_shortage.count(node.item_id) && live_shortage[node.item_id] <= 0) {
-						if (harvested_since_leave_[aid] > 0) {
-							log << "[Tick " << t << "] Agent " << aid << " harvested "
-							    << harvested_since_leave_[aid] << " of item " << node.item_id
-							    << " at RP" << best_rp->resource_point_id << " (stopped, shortage filled)" << std::endl;
-						}
-						current_task_[aid] = -1;
-						harvested_since_leave_[aid] = 0;
-						current_batch_[aid] = 0;
-						continue;
-					}
-					if (node.produced >= node.demand) {
-						if (harvested_since_leave_[aid] > 0) {
-							log << "[Tick " << t << "] Agent " << aid << " harvested "
-							    << harvested_since_leave_[aid] << " of item " << node.item_id
-							    << " at RP" << best_rp->resource_point_id << std::endl;
-						}
-						if (tree_.remainingNeed(node, world_) == 0) {
-							current_task_[aid] = -1;
-						}
-						harvested_since_leave_[aid] = 0;
-						current_batch_[aid] = 0;
-					}
-					ticks_left_[aid] = 0;
-				}
-			} else if (node.type == TaskType::Craft) {
-				const CraftingRecipe* recipe = world_.getCraftingSystem().getRecipe(node.crafting_id);
-				if (!recipe) { current_task_[aid] = -1; continue; }
-				if (ticks_left_[aid] == 0) {
-					if (!world_.hasEnoughItems(recipe->materials)) {
-						node.allocated = std::max(0, node.allocated - current_batch_[aid]);
-						current_task_[aid] = -1;
-						current_batch_[aid] = 0;
-						continue;
-					}
-					for (size_t mi = 0; mi < recipe->materials.size(); ++mi) {
-						world_.removeItem(recipe->materials[mi].item_id, recipe->materials[mi].quantity_required);
-					}
-					ticks_left_[aid] = std::max(1, recipe->production_time * 20);
-				}
-				ticks_left_[aid]--;
-				if (ticks_left_[aid] == 0) {
-					int produced = recipe->quantity_produced > 0 ? recipe->quantity_produced : 1;
-					world_.addItem(recipe->product_item_id, produced);
-					node.produced += produced;
-					node.allocated = std::max(0, node.allocated - produced);
-					if (node.produced > node.demand) node.produced = node.demand;
-					log << "[Tick " << t << "] Agent " << aid << " crafted item " << node.item_id << std::endl;
-					if (tree_.remainingNeed(node, world_) == 0) {
-						current_task_[aid] = -1;
-					}
-					current_batch_[aid] = 0;
-				}
-			} else { // Build
-				Building* b = world_.getBuilding(node.building_id);
-				if (!b) { current_task_[aid] = -1; continue; }
-				if (b->isCompleted) { node.produced = node.demand; current_task_[aid] = -1; continue; }
-				int dist = agents_[aid]->getDistanceTo(b->x, b->y);
-				if (dist > 0) { agents_[aid]->moveStep(b->x, b->y); continue; }
-				if (ticks_left_[aid] == 0) {
-					std::vector<CraftingMaterial> mats;
-					for (size_t mi = 0; mi < b->required_materials.size(); ++mi) {
-						mats.push_back(CraftingMaterial(b->required_materials[mi].first, b->required_materials[mi].second));
-					}
-					if (!world_.hasEnoughItems(mats)) {
-						node.allocated = std::max(0, node.allocated - 1);
-						current_task_[aid] = -1;
-						current_batch_[aid] = 0;
-						continue;
-					}
-					for (size_t mi = 0; mi < mats.size(); ++mi) {
-						world_.removeItem(mats[mi].item_id, mats[mi].quantity_required);
-					}
-					ticks_left_[aid] = std::max(1, b->construction_time * 20);
-					current_batch_[aid] = 1;
-				}
-				ticks_left_[aid]--;
-				if (ticks_left_[aid] == 0) {
-					b->completeConstruction();
-					node.produced = node.demand;
-					node.allocated = std::max(0, node.allocated - 1);
-					tree_.applyEvent(TaskInfo{1, node.building_id, 0, 0, node.coord}, world_);
-					log << "[Tick " << t << "] Agent " << aid << " built building " << node.building_id << std::endl;
-					current_task_[aid] = -1;
-					current_batch_[aid] = 0;
-				}
+	// 移动
+	for (size_t i = 0; i < travellers.size(); ++i) {
+		agents_[travellers[i].aid]->moveStep(travellers[i].x, travellers[i].y);
+	}
+	for (size_t i = 0; i < haulers.size(); ++i) haulStep(haulers[i]);
+
+	// 采集：harvesters 都已持有所在资源点的采集位
+	for (size_t i = 0; i < harvesters.size(); ++i) {
+		size_t aid = harvesters[i].aid;
+		ResourcePoint* best_rp = harvesters[i].rp;
+		TFNode& node = tree_.get(current_task_[aid]);
+		if (ticks_left_[aid] == 0) ticks_left_[aid] = 20; // 1s = 20 ticks
+		ticks_left_[aid]--;
+		if (ticks_left_[aid] != 0) continue;
+		// 本 tick 其他采集者的产出要到 drainEvents 才入库，这里只按 tick 开始时的库存截断
+		int need = gatherNeed(aid, node);
+		int harvest = std::min(10, std::min(need, world_.resourceAvailable(*best_rp)));
+		if (harvest > 0) {
+			world_.harvestResource(*best_rp, harvest);
+			harvested_since_leave_[aid] += harvest;
+			if (best_rp->remaining_resource <= 0) markGatherers(node.item_id); // 资源点枯竭
+		}
+		harvest_rp_[aid] = best_rp->resource_point_id;
+		if (carry_capacity_ > 0) agents_[aid]->inventory.add(node.item_id, harvest, node.id); // 送达时才入库
+		else events_.push(TaskInfo{2, node.id, node.item_id, harvest, std::make_pair(best_rp->x, best_rp->y), static_cast<int>(aid)});
+		ticks_left_[aid] = 0;
+	}
+
+	// 制作计时
+	for (size_t i = 0; i < crafters.size(); ++i) {
+		size_t aid = crafters[i];
+		TFNode& node = tree_.get(current_task_[aid]);
+		const CraftingRecipe* recipe = world_.getCraftingSystem().getRecipe(node.crafting_id);
+		if (!recipe) { setIdle(aid); continue; }
+		if (ticks_left_[aid] == 0) {
+			if (!world_.hasEnoughItems(recipe->materials)) {
+				node.allocated = std::max(0, node.allocated - current_batch_[aid]);
+				setIdle(aid);
+				current_batch_[aid] = 0;
+				continue;
+			}
+			for (size_t mi = 0; mi < recipe->materials.size(); ++mi) {
+				world_.removeItem(recipe->materials[mi].item_id, recipe->materials[mi].quantity_required);
 			}
+			ticks_left_[aid] = std::max(1, recipe->production_time * 20);
 		}
+		ticks_left_[aid]--;
+		if (ticks_left_[aid] != 0) continue;
+		int produced = recipe->quantity_produced > 0 ? recipe->quantity_produced : 1;
+		if (carry_capacity_ > 0) agents_[aid]->inventory.add(recipe->product_item_id, produced, node.id);
+		else events_.push(TaskInfo{2, node.id, recipe->product_item_id, produced, std::make_pair(agents_[aid]->x, agents_[aid]->y), static_cast<int>(aid)});
+	}
 
-		if (true) { // 每 tick 输出一次 NPC 位置和需求/存量/任务
-			log << "[Tick " << t << "] NPCs: ";
-			for (size_t i = 0; i < agents_.size(); ++i) {
-				log << "(" << agents_[i]->x << "," << agents_[i]->y << ")";
-				if (i + 1 < agents_.size()) log << " ";
+	// 建造计时
+	for (size_t i = 0; i < builders.size(); ++i) {
+		size_t aid = builders[i];
+		TFNode& node = tree_.get(current_task_[aid]);
+		Building* b = world_.getBuilding(node.building_id);
+		if (tree_.isCompleted(node.id, world_)) { setIdle(aid); continue; }
+		if (ticks_left_[aid] == 0) {
+			std::vector<CraftingMaterial> mats;
+			for (size_t mi = 0; mi < b->required_materials.size(); ++mi) {
+				mats.push_back(CraftingMaterial(b->required_materials[mi].first, b->required_materials[mi].second));
+			}
+			if (!world_.hasEnoughItems(mats)) {
+				node.allocated = std::max(0, node.allocated - 1);
+				setIdle(aid);
+				current_batch_[aid] = 0;
+				continue;
 			}
-			// 汇总所有物品的缺口与库存（不含建筑伪 ID）
-			std::map<int,int> inv_map;
-			for (std::map<int, Item>::const_iterator it = world_.getItems().begin(); it != world_.getItems().end(); ++it) {
-				if (it->first >= 10000) continue;
-				inv_map[it->first] = it->second.quantity;
+			for (size_t mi = 0; mi < mats.size(); ++mi) {
+				world_.removeItem(mats[mi].item_id, mats[mi].quantity_required);
 			}
-			std::map<int,int> need_map;
-			for (size_t n = 0; n < tree_.nodes().size(); ++n) {
-				const TFNode& node = tree_.nodes()[n];
-				if (node.type == TaskType::Build) continue;
-				if (node.item_id >= 10000) continue;
-				int rem = tree_.remainingNeed(node, world_);
-				if (rem > 0) need_map[node.item_id] += rem;
+			ticks_left_[aid] = std::max(1, b->construction_time * 20);
+			current_batch_[aid] = 1;
+		}
+		ticks_left_[aid]--;
+		if (ticks_left_[aid] != 0) continue;
+		events_.push(TaskInfo{1, node.building_id, 0, 0, tree_.meta(node.id).coord, static_cast<int>(aid), tree_.meta(node.id).site});
+	}
+}
+
+void Simulator::drainEvents(int t) {
+	std::vector<TaskInfo> batch;
+	if (events_.drain(batch) == 0) return;
+	tree_.applyEvents(batch, world_);
+	// 缺口按整批入库后的状态算一次，供本批所有采集者判断是否停手
+	std::map<int, int> live_shortage;
+	for (size_t i = 0; i < batch.size(); ++i) {
+		if (batch[i].type == 2 && batch[i].target_id >= 0 && tree_.get(batch[i].target_id).type == TaskType::Gather) {
+			live_shortage = scheduler_.computeShortage(tree_, world_);
+			break;
+		}
+	}
+	bool released = false;
+	for (size_t i = 0; i < batch.size(); ++i) {
+		const TaskInfo& ev = batch[i];
+		size_t aid = static_cast<size_t>(ev.agent);
+		if (ev.type == 1) {
+			released = released || tree_.lazyExpansion();
+			log_ << "[Tick " << t << "] Agent " << aid << " built building " << ev.target_id << std::endl;
+			emit(t, 1, aid, ev.target_id, 1);
+			setIdle(aid);
+			current_batch_[aid] = 0;
+			markGatherers(-1); // 建造完成：工作台解锁，采集者需复查是否让位
+			if (ev.target_id == kStorageBuilding) storage_sites_.push_back(ev.coord);
+			continue;
+		}
+		if (carry_capacity_ > 0 && (ev.target_id < 0 || current_task_[aid] != ev.target_id)) {
+			// 送达的是已换掉（或已释放）的任务的货：只入库
+			const Item* meta = world_.getItemMeta(ev.item_id);
+			log_ << "[Tick " << t << "] Agent " << aid << " delivered " << ev.quantity << " of item " << ev.item_id << std::endl;
+			emit(t, meta && meta->is_resource ? 3 : 2, aid, ev.item_id, ev.quantity);
+			continue;
+		}
+		if (tree_.isFreed(ev.target_id)) {
+			// 同批内所属建筑已完成、子树已释放：产出照常入库，agent 改做别的
+			if (current_task_[aid] == ev.target_id) setIdle(aid);
+			harvested_since_leave_[aid] = 0;
+			current_batch_[aid] = 0;
+			continue;
+		}
+		const TFNode& node = tree_.get(ev.target_id);
+		if (node.type == TaskType::Craft) {
+			log_ << "[Tick " << t << "] Agent " << aid << " crafted item " << node.item_id << std::endl;
+			emit(t, 2, aid, node.item_id, ev.quantity);
+			if (tree_.remainingNeed(node, world_) == 0) {
+				setIdle(aid);
 			}
-			log << " | Needs/Inv: ";
-			std::set<int> all_ids;
-			for (std::map<int,int>::const_iterator it = inv_map.begin(); it != inv_map.end(); ++it) all_ids.insert(it->first);
-			for (std::map<int,int>::const_iterator it = need_map.begin(); it != need_map.end(); ++it) all_ids.insert(it->first);
-			if (all_ids.empty()) log << "None";
-			size_t cnt = 0;
-			for (std::set<int>::const_iterator it = all_ids.begin(); it != all_ids.end(); ++it, ++cnt) {
-				int iid = *it;
-				int need = need_map.count(iid) ? need_map[iid] : 0;
-				int inv = inv_map.count(iid) ? inv_map[iid] : 0;
-				log << "I" << iid << ":" << need << "/" << inv;
-				if (cnt + 1 < all_ids.size()) log << " ";
+			current_batch_[aid] = 0;
+			continue;
+		}
+		if (ev.quantity > 0) emit(t, 3, aid, node.item_id, ev.quantity);
+		// 如果全局缺口已补足，立即停止采集
+		std::map<int, int>::const_iterator live = live_shortage.find(node.item_id);
+		if (live != live_shortage.end() && live->second <= 0) {
+			if (harvested_since_leave_[aid] > 0) {
+				log_ << "[Tick " << t << "] Agent " << aid << " harvested "
+				     << harvested_since_leave_[aid] << " of item " << node.item_id
+				     << " at RP" << harvest_rp_[aid] << " (stopped, shortage filled)" << std::endl;
 			}
-			// NPC 当前任务概览
-			log << " | Tasks: ";
-			for (size_t i = 0; i < current_task_.size(); ++i) {
-				if (i > 0) log << " ";
-				if (current_task_[i] == -1) {
-					log << "A" << i << ":Idle";
-				} else {
-					const TFNode& n = tree_.get(current_task_[i]);
-					char tcode = (n.type == TaskType::Gather ? 'G' : (n.type == TaskType::Craft ? 'C' : 'B'));
-					int target = (n.type == TaskType::Build) ? n.building_id : n.item_id;
-					log << "A" << i << ":" << tcode << target;
-				}
+			setIdle(aid);
+			harvested_since_leave_[aid] = 0;
+			current_batch_[aid] = 0;
+			continue;
+		}
+		if (node.produced >= node.demand) {
+			if (harvested_since_leave_[aid] > 0) {
+				log_ << "[Tick " << t << "] Agent " << aid << " harvested "
+				     << harvested_since_leave_[aid] << " of item " << node.item_id
+				     << " at RP" << harvest_rp_[aid] << std::endl;
 			}
-			log << std::endl;
+			if (tree_.remainingNeed(node, world_) == 0) {
+				setIdle(aid);
+			}
+			harvested_since_leave_[aid] = 0;
+			current_batch_[aid] = 0;
+		}
+	}
+	if (released) dropFreedNodes();
+}
+
+int Simulator::addBuildOrder(int building_type, int x, int y, double priority) {
+	int order = tree_.addBuildOrder(building_type, std::make_pair(x, y), priority, world_);
+	if (order < 0) return -1;
+	replan_pending_ = true;
+	markGatherers(-1); // 新订单可能值得让采集者改做
+	return order;
+}
+
+bool Simulator::cancelBuildOrder(int order) {
+	if (!tree_.cancelBuildOrder(order)) return false;
+	dropFreedNodes();
+	replan_pending_ = true;
+	return true;
+}
+
+void Simulator::dropFreedNodes() {
+	// 释放的槽位要到下一 tick 的 syncWithWorld 才会被复用，在此之前清掉所有引用
+	for (size_t aid = 0; aid < agents_.size(); ++aid) {
+		std::vector<int>& b = agents_[aid]->bundle;
+		for (std::vector<int>::iterator it = b.begin(); it != b.end();) {
+			if (tree_.isFreed(*it)) it = b.erase(it);
+			else ++it;
+		}
+		AgentInventory& inv = agents_[aid]->inventory;
+		for (int k = 0; k < AgentInventory::kSlots; ++k) {
+			if (inv.slots[k].source >= 0 && tree_.isFreed(inv.slots[k].source)) inv.slots[k].source = -1;
+		}
+		if (current_task_[aid] >= 0 && tree_.isFreed(current_task_[aid])) {
+			setIdle(aid);
+			ticks_left_[aid] = 0;
+			harvested_since_leave_[aid] = 0;
+			current_batch_[aid] = 0;
+		}
+	}
+}
+
+bool Simulator::needsHaul(size_t aid) const {
+	if (carry_capacity_ <= 0) return false;
+	const AgentInventory& inv = agents_[aid]->inventory;
+	if (inv.empty()) return false;
+	if (inv.freeSpace() == 0) return true;
+	int tid = current_task_[aid];
+	if (tid < 0 || tree_.get(tid).type != TaskType::Gather) return true; // 制作产出每批送一次；开工前先卸下别的货
+	for (int k = 0; k < AgentInventory::kSlots; ++k) {
+		if (inv.slots[k].quantity > 0 && inv.slots[k].source != tid) return true; // 上一个任务的货
+	}
+	return gatherNeed(aid, tree_.get(tid)) <= 0;
+}
+
+int Simulator::gatherNeed(size_t aid, const TFNode& node) const {
+	int need = tree_.remainingNeedRaw(node, world_);
+	if (carry_capacity_ <= 0) return need;
+	const AgentInventory& inv = agents_[aid]->inventory;
+	return std::min(need - inv.carried(node.item_id, node.id), inv.freeSpace());
+}
+
+std::pair<int, int> Simulator::dropPoint(size_t aid, bool& consumer) const {
+	const Agent& ag = *agents_[aid];
+	std::pair<int, int> best(ag.x, ag.y); // 没有仓库也没有消费地时原地卸货
+	int best_dist = -1;
+	for (size_t i = 0; i < storage_sites_.size(); ++i) {
+		int d = ag.getDistanceTo(storage_sites_[i].first, storage_sites_[i].second);
+		if (best_dist < 0 || d < best_dist) { best_dist = d; best = storage_sites_[i]; }
+	}
+	consumer = false;
+	// 消费地：货物来源节点的父节点使用它的地方（工地，或已建成的工作台）
+	int source = -1;
+	for (int k = 0; k < AgentInventory::kSlots && source < 0; ++k) {
+		if (ag.inventory.slots[k].quantity > 0) source = ag.inventory.slots[k].source;
+	}
+	if (source < 0 || tree_.get(source).parent < 0) return best;
+	int parent = tree_.get(source).parent;
+	const TFNode& p = tree_.get(parent);
+	std::pair<int, int> at;
+	if (p.type == TaskType::Build) {
+		at = tree_.meta(parent).coord;
+	} else {
+		const CraftingRecipe* r = world_.getCraftingSystem().getRecipe(p.crafting_id);
+		const Building* wb = r && r->required_building_id > 0 ? world_.getBuilding(r->required_building_id) : nullptr;
+		if (!wb || !wb->isCompleted) return best;
+		at = std::make_pair(wb->x, wb->y);
+	}
+	int d = ag.getDistanceTo(at.first, at.second);
+	if (best_dist < 0 || d < best_dist) {
+		best = at;
+		consumer = true;
+	}
+	return best;
+}
+
+bool Simulator::haulStep(size_t aid) {
+	bool consumer = false;
+	std::pair<int, int> to = dropPoint(aid, consumer);
+	Agent& ag = *agents_[aid];
+	if (ag.getDistanceTo(to.first, to.second) > 0 && !ag.moveStep(to.first, to.second)) return false;
+	// 到达：每格货物作为一次产出事件在本 tick 末入库，来源节点仍在时记入其 produced
+	AgentInventory& inv = ag.inventory;
+	for (int k = 0; k < AgentInventory::kSlots; ++k) {
+		const AgentInventory::Slot& s = inv.slots[k];
+		if (s.quantity <= 0) continue;
+		events_.push(TaskInfo{2, s.source, s.item_id, s.quantity, to, static_cast<int>(aid)});
+		haul_stats_.items += s.quantity;
+	}
+	inv.clear();
+	haul_stats_.trips++;
+	if (consumer) haul_stats_.to_consumer++;
+	return true;
+}
+
+bool Simulator::claimResourcePoint(size_t aid, int rp_id) {
+	if (slots_.heldBy(aid) == rp_id) return true;
+	if (!slots_.hasFree(rp_id)) return false;
+	releaseResourcePoint(aid);
+	slots_.reserve(aid, rp_id);
+	slot_stats_.reservations++;
+	return true;
+}
+
+void Simulator::releaseResourcePoint(size_t aid) {
+	int rp_id = slots_.release(aid);
+	if (rp_id >= 0 && coroutine_agents_) behaviors_.signal(EventKey{EventKind::ResourcePoint, rp_id}, tick_);
+}
+
+void Simulator::executeCoroutines(int t) {
+	// 任务变化（空闲、中断、新开工）的 agent：丢弃旧协程，有任务则从本 tick 的移动阶段开始新协程
+	std::sort(respawn_.begin(), respawn_.end());
+	respawn_.erase(std::unique(respawn_.begin(), respawn_.end()), respawn_.end());
+	std::vector<size_t> respawn;
+	respawn.swap(respawn_);
+	for (size_t i = 0; i < respawn.size(); ++i) {
+		size_t aid = respawn[i];
+		behaviors_.stop(aid);
+		if (needsHaul(aid)) { behaviors_.start(aid, haulBehavior(aid), t); continue; }
+		int tid = current_task_[aid];
+		if (tid == -1) continue;
+		const TFNode& node = tree_.get(tid);
+		if (node.type == TaskType::Gather) behaviors_.start(aid, gatherBehavior(aid, tid), t);
+		else if (node.type == TaskType::Craft) behaviors_.start(aid, craftBehavior(aid, tid), t);
+		else behaviors_.start(aid, buildBehavior(aid, tid), t);
+	}
+	behaviors_.runTick(t);
+}
+
+Behavior Simulator::gatherBehavior(size_t aid, int tid) {
+	const EventKey item_key{EventKind::Item, tree_.get(tid).item_id};
+	while (true) {
+		TFNode& node = tree_.get(tid);
+		int dist = 0;
+		ResourcePoint* rp = gatherNeed(aid, node) > 0 ? targetResourcePoint(aid, node.item_id, dist) : nullptr;
+		if (!rp) { setIdle(aid); co_return; }
+		if (dist > 0) {
+			harvested_since_leave_[aid] = 0;
+			agents_[aid]->moveStep(rp->x, rp->y);
+			co_await behaviors_.at(aid, behaviors_.now() + 1, Phase::Move);
+			continue;
+		}
+		const int rp_id = rp->resource_point_id;
+		if (!claimResourcePoint(aid, rp_id)) {
+			// 资源点满员：等有人释放，或库存变化后重新判断是否还要采
+			const int wait_from = behaviors_.now();
+			co_await behaviors_.until(aid, -1, Phase::Harvest, EventKey{EventKind::ResourcePoint, rp_id}, item_key);
+			slot_stats_.wait_ticks += behaviors_.now() - wait_from;
+			continue;
+		}
+		// 采集一批 20 tick（含到达当 tick），期间库存变化时复查缺口
+		const int due = behaviors_.now() + 19;
+		ticks_left_[aid] = 20;
+		bool cancelled = false;
+		while (true) {
+			WakeReason why = co_await behaviors_.until(aid, due, Phase::Harvest, item_key);
+			if (why == WakeReason::Timer || behaviors_.now() >= due) break;
+			if (gatherNeed(aid, tree_.get(tid)) <= 0) { cancelled = true; break; }
+		}
+		ticks_left_[aid] = 0;
+		if (cancelled) { setIdle(aid); co_return; }
+
+		// 产出经事件队列在本 tick 末入库；若因此停手，drainEvents 置空闲，下一 tick 本协程即被替换
+		const TFNode& gnode = tree_.get(tid);
+		ResourcePoint& best_rp = world_.getResourcePoints()[rp_id];
+		int need = gatherNeed(aid, gnode);
+		int harvest = std::min(10, std::min(need, world_.resourceAvailable(best_rp)));
+		if (harvest > 0) {
+			world_.harvestResource(best_rp, harvest);
+			harvested_since_leave_[aid] += harvest;
+			if (best_rp.remaining_resource <= 0) markGatherers(gnode.item_id);
+		}
+		harvest_rp_[aid] = rp_id;
+		if (carry_capacity_ > 0) {
+			agents_[aid]->inventory.add(gnode.item_id, harvest, tid);
+			if (needsHaul(aid)) { releaseResourcePoint(aid); respawn_.push_back(aid); co_return; } // 下一 tick 改跑 haulBehavior
+		} else {
+			events_.push(TaskInfo{2, tid, gnode.item_id, harvest, std::make_pair(best_rp.x, best_rp.y), static_cast<int>(aid)});
+		}
+		co_await behaviors_.at(aid, behaviors_.now() + 1, Phase::Move);
+	}
+}
+
+Behavior Simulator::haulBehavior(size_t aid) {
+	while (!haulStep(aid)) co_await behaviors_.at(aid, behaviors_.now() + 1, Phase::Move);
+	respawn_.push_back(aid); // 卸完货，下一 tick 按当前任务重建协程
+}
+
+Behavior Simulator::craftBehavior(size_t aid, int tid) {
+	co_await behaviors_.at(aid, behaviors_.now(), Phase::Craft);
+	while (true) {
+		TFNode& node = tree_.get(tid);
+		const CraftingRecipe* recipe = world_.getCraftingSystem().getRecipe(node.crafting_id);
+		if (!recipe) { setIdle(aid); co_return; }
+		if (!world_.hasEnoughItems(recipe->materials)) {
+			node.allocated = std::max(0, node.allocated - current_batch_[aid]);
+			current_batch_[aid] = 0;
+			setIdle(aid);
+			co_return;
+		}
+		for (size_t mi = 0; mi < recipe->materials.size(); ++mi) {
+			world_.removeItem(recipe->materials[mi].item_id, recipe->materials[mi].quantity_required);
+		}
+		const int duration = std::max(1, recipe->production_time * 20);
+		ticks_left_[aid] = duration;
+		if (duration > 1) co_await behaviors_.at(aid, behaviors_.now() + duration - 1, Phase::Craft);
+		ticks_left_[aid] = 0;
+
+		int produced = recipe->quantity_produced > 0 ? recipe->quantity_produced : 1;
+		if (carry_capacity_ > 0) {
+			agents_[aid]->inventory.add(recipe->product_item_id, produced, tid);
+			respawn_.push_back(aid); // 每批送一次货
+			co_return;
+		}
+		events_.push(TaskInfo{2, tid, recipe->product_item_id, produced, std::make_pair(agents_[aid]->x, agents_[aid]->y), static_cast<int>(aid)});
+		co_await behaviors_.at(aid, behaviors_.now() + 1, Phase::Craft);
+	}
+}
+
+Behavior Simulator::buildBehavior(size_t aid, int tid) {
+	const int building_id = tree_.get(tid).building_id;
+	const std::pair<int,int> site = tree_.meta(tid).coord;
+	while (true) {
+		if (!world_.getBuilding(building_id) || tree_.isCompleted(tid, world_)) { setIdle(aid); co_return; }
+		if (agents_[aid]->getDistanceTo(site.first, site.second) == 0) break;
+		agents_[aid]->moveStep(site.first, site.second);
+		co_await behaviors_.at(aid, behaviors_.now() + 1, Phase::Move);
+	}
+	co_await behaviors_.at(aid, behaviors_.now(), Phase::Build);
+	Building* b = world_.getBuilding(building_id);
+	if (tree_.isCompleted(tid, world_)) { setIdle(aid); co_return; }
+	std::vector<CraftingMaterial> mats;
+	for (size_t mi = 0; mi < b->required_materials.size(); ++mi) {
+		mats.push_back(CraftingMaterial(b->required_materials[mi].first, b->required_materials[mi].second));
+	}
+	if (!world_.hasEnoughItems(mats)) {
+		TFNode& node = tree_.get(tid);
+		node.allocated = std::max(0, node.allocated - 1);
+		current_batch_[aid] = 0;
+		setIdle(aid);
+		co_return;
+	}
+	for (size_t mi = 0; mi < mats.size(); ++mi) {
+		world_.removeItem(mats[mi].item_id, mats[mi].quantity_required);
+	}
+	const int duration = std::max(1, b->construction_time * 20);
+	const int due = behaviors_.now() + duration - 1;
+	ticks_left_[aid] = duration;
+	current_batch_[aid] = 1;
+	while (behaviors_.now() < due) {
+		co_await behaviors_.until(aid, due, Phase::Build, EventKey{EventKind::Building, building_id});
+		if (tree_.isCompleted(tid, world_) && behaviors_.now() < due) { // 被他人抢先建成
+			ticks_left_[aid] = 0;
+			setIdle(aid);
+			co_return;
+		}
+	}
+	ticks_left_[aid] = 0;
+	events_.push(TaskInfo{1, building_id, 0, 0, tree_.meta(tid).coord, static_cast<int>(aid), tree_.meta(tid).site});
+}
+
+void Simulator::logTick(int t) {
+	if (!log_.is_open()) return; // 嵌入时关闭日志，跳过逐 tick 汇总
+	// 每 tick 输出一次 NPC 位置和需求/存量/任务
+	log_ << "[Tick " << t << "] NPCs: ";
+	for (size_t i = 0; i < agents_.size(); ++i) {
+		log_ << "(" << agents_[i]->x << "," << agents_[i]->y << ")";
+		if (i + 1 < agents_.size()) log_ << " ";
+	}
+	// 汇总所有物品的缺口与库存（不含建筑伪 ID）
+	std::map<int,int> inv_map;
+	for (std::map<int, Item>::const_iterator it = world_.getItems().begin(); it != world_.getItems().end(); ++it) {
+		if (it->first >= 10000) continue;
+		inv_map[it->first] = it->second.quantity;
+	}
+	std::map<int,int> need_map;
+	for (size_t n = 0; n < tree_.nodes().size(); ++n) {
+		const TFNode& node = tree_.nodes()[n];
+		if (node.type == TaskType::Build) continue;
+		if (node.item_id >= 10000) continue;
+		int rem = tree_.remainingNeed(node, world_);
+		if (rem > 0) need_map[node.item_id] += rem;
+	}
+	log_ << " | Needs/Inv: ";
+	std::set<int> all_ids;
+	for (std::map<int,int>::const_iterator it = inv_map.begin(); it != inv_map.end(); ++it) all_ids.insert(it->first);
+	for (std::map<int,int>::const_iterator it = need_map.begin(); it != need_map.end(); ++it) all_ids.insert(it->first);
+	if (all_ids.empty()) log_ << "None";
+	size_t cnt = 0;
+	for (std::set<int>::const_iterator it = all_ids.begin(); it != all_ids.end(); ++it, ++cnt) {
+		int iid = *it;
+		int need = need_map.count(iid) ? need_map[iid] : 0;
+		int inv = inv_map.count(iid) ? inv_map[iid] : 0;
+		log_ << "I" << iid << ":" << need << "/" << inv;
+		if (cnt + 1 < all_ids.size()) log_ << " ";
+	}
+	// NPC 当前任务概览
+	log_ << " | Tasks: ";
+	for (size_t i = 0; i < current_task_.size(); ++i) {
+		if (i > 0) log_ << " ";
+		if (current_task_[i] == -1) {
+			log_ << "A" << i << ":Idle";
+		} else {
+			const TFNode& n = tree_.get(current_task_[i]);
+			char tcode = (n.type == TaskType::Gather ? 'G' : (n.type == TaskType::Craft ? 'C' : 'B'));
+			int target = (n.type == TaskType::Build) ? n.building_id : n.item_id;
+			log_ << "A" << i << ":" << tcode << target;
 		}
 	}
-	log.close();
+	log_ << std::endl;
 }
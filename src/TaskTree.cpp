@@ -1,12 +1,15 @@
 #include "../includes/TaskTree.hpp"
+#include <algorithm>
 
 std::vector<int> TaskTree::ready(const WorldState& world) const {
 	std::vector<int> res;
 	for (size_t i = 0; i < nodes_.size(); ++i) {
 		if (isCompleted(static_cast<int>(i), world)) continue;
+		if (pending_[i] && !materialsCovered(static_cast<int>(i), world)) continue; // 子节点未生成：材料须已备齐
 		bool ok = true;
-		for (size_t j = 0; j < nodes_[i].children.size(); ++j) {
-			if (!isCompleted(nodes_[i].children[j], world)) { ok = false; break; }
+		const int* c = child_idx_.data() + nodes_[i].child_begin;
+		for (int j = 0; j < nodes_[i].child_count; ++j) {
+			if (!isCompleted(c[j], world)) { ok = false; break; }
 		}
 		if (ok) res.push_back(static_cast<int>(i));
 	}
@@ -25,6 +28,21 @@ const std::vector<TFNode>& TaskTree::nodes() const {
 	return nodes_;
 }
 
+NodeRange TaskTree::children(int id) const {
+	const TFNode& n = nodes_[id];
+	const int* base = child_idx_.data();
+	NodeRange r = {base + n.child_begin, base + n.child_begin + n.child_count};
+	return r;
+}
+
+TFNodeMeta& TaskTree::meta(int id) {
+	return meta_[id];
+}
+
+const TFNodeMeta& TaskTree::meta(int id) const {
+	return meta_[id];
+}
+
 void TaskTree::setPriorityWeights(const std::map<int,double>& weights) {
 	priority_weights_ = weights;
 }
@@ -33,18 +51,48 @@ void TaskTree::setPinnedItems(const std::set<int>& pins) {
 	pinned_items_ = pins;
 }
 
-int TaskTree::addNode(const TFNode& node) {
+int TaskTree::addNode(const TFNode& node, const TFNodeMeta& meta) {
 	TFNode copy = node;
-	copy.id = static_cast<int>(nodes_.size());
-	nodes_.push_back(copy);
+	if (!free_.empty()) {
+		// 复用已释放的槽位（仅惰性模式会产生）
+		copy.id = free_.back();
+		free_.pop_back();
+		nodes_[copy.id] = copy;
+		meta_[copy.id] = meta;
+		freed_[copy.id] = 0;
+	} else {
+		copy.id = static_cast<int>(nodes_.size());
+		nodes_.push_back(copy);
+		meta_.push_back(meta);
+		pending_.push_back(0);
+		freed_.push_back(0);
+	}
+	if (copy.type == TaskType::Build) building_nodes_[copy.building_id].push_back(copy.id);
+	else item_nodes_[copy.item_id].push_back(copy.id);
+	peak_live_ = std::max(peak_live_, liveNodeCount());
 	return copy.id;
 }
 
-void TaskTree::addEdge(int parent, int child) {
-	if (parent < 0 || child < 0) return;
-	if (parent >= static_cast<int>(nodes_.size()) || child >= static_cast<int>(nodes_.size())) return;
-	nodes_[parent].children.push_back(child);
-	nodes_[child].parents.push_back(parent);
+void TaskTree::linkChildren(int parent, const std::vector<int>& kids) {
+	if (parent < 0 || parent >= static_cast<int>(nodes_.size())) return;
+	nodes_[parent].child_begin = static_cast<int>(child_idx_.size());
+	nodes_[parent].child_count = static_cast<int>(kids.size());
+	for (size_t i = 0; i < kids.size(); ++i) {
+		child_idx_.push_back(kids[i]);
+		nodes_[kids[i]].parent = parent;
+	}
+}
+
+void TaskTree::compactTopology() {
+	std::vector<int> packed;
+	packed.reserve(child_idx_.size());
+	for (size_t i = 0; i < nodes_.size(); ++i) {
+		TFNode& n = nodes_[i];
+		int begin = static_cast<int>(packed.size());
+		packed.insert(packed.end(), child_idx_.begin() + n.child_begin, child_idx_.begin() + n.child_begin + n.child_count);
+		n.child_begin = begin;
+	}
+	child_idx_.swap(packed);
 }
 
 void TaskTree::addBuildingRequire(int building_type, const std::pair<int,int>& coord) {
@@ -76,25 +124,48 @@ bool TaskTree::isPinned(int item_id) const {
 	return pinned_items_.count(item_id) > 0;
 }
 
+void TaskTree::syncItemNode(TFNode& n, const WorldState& world) {
+	// 对物品节点，将 produced 与当前库存对齐（不会累加），避免库存被消耗后仍认为已完成
+	std::map<int, Item>::const_iterator it = world.getItems().find(n.item_id);
+	int have = (it != world.getItems().end()) ? it->second.quantity : 0;
+	if (have < 0) have = 0;
+	if (n.produced != have) {
+		bool was_done = n.produced >= n.demand;
+		n.produced = have > n.demand ? n.demand : have;
+		if (was_done != (n.produced >= n.demand)) refreshRank(n.id);
+	}
+}
+
 void TaskTree::syncWithWorld(WorldState& world) {
-	// Mark completed buildings；不再用库存判定物品完成
-	for (size_t i = 0; i < nodes_.size(); ++i) {
-		TFNode& n = nodes_[i];
-		if (n.type == TaskType::Build) {
-			Building* b = world.getBuilding(n.building_id);
-			if (b && b->isCompleted) {
-				n.produced = n.demand;
-			}
-		} else {
-			// 对物品节点，将 produced 与当前库存对齐（不会累加），避免库存被消耗后仍认为已完成
-			std::map<int, Item>::const_iterator it = world.getItems().find(n.item_id);
-			int have = (it != world.getItems().end()) ? it->second.quantity : 0;
-			if (have < 0) have = 0;
-			if (n.produced != have) {
-				n.produced = have > n.demand ? n.demand : have;
+	if (!synced_) {
+		// Mark completed buildings；不再用库存判定物品完成
+		for (size_t i = 0; i < nodes_.size(); ++i) {
+			TFNode& n = nodes_[i];
+			if (n.type == TaskType::Build) {
+				// 世界里每类建筑只有一处原始工地，运行时订单的完成只经 applyEvent 记入
+				Building* b = world.getBuilding(n.building_id);
+				if (b && b->isCompleted && n.produced < n.demand && meta_[i].coord == std::make_pair(b->x, b->y)) {
+					n.produced = n.demand;
+					refreshRank(n.id);
+				}
+			} else {
+				syncItemNode(n, world);
 			}
 		}
+		synced_ = true;
+		if (lazy_) materialize(world);
+		return;
 	}
+	// 增量：只更新库存有变化的物品节点
+	for (std::set<int>::const_iterator it = world.dirtyItems().begin(); it != world.dirtyItems().end(); ++it) {
+		std::map<int, std::vector<int> >::const_iterator idx = item_nodes_.find(*it);
+		if (idx == item_nodes_.end()) continue;
+		for (size_t k = 0; k < idx->second.size(); ++k) {
+			syncItemNode(nodes_[idx->second[k]], world);
+		}
+	}
+	// 建筑完成按工地由 applyEvent 记入；WorldState 的建筑完成只表示该类建筑已可用（工作台判定），这里不再据此标记节点
+	if (lazy_) materialize(world);
 }
 
 void TaskTree::applyEvent(const TaskInfo& info, WorldState& world) {
@@ -109,35 +180,65 @@ void TaskTree::applyEvent(const TaskInfo& info, WorldState& world) {
 				}
 			}
 		}
-		Building* b = world.getBuilding(info.target_id);
-		if (b) b->completeConstruction();
-		// 将该建筑对应任务及其子树需求清零，避免重复采集
-		for (size_t i = 0; i < nodes_.size(); ++i) {
-			if (nodes_[i].type == TaskType::Build && nodes_[i].building_id == info.target_id) {
-				for (size_t c = 0; c < nodes_[i].children.size(); ++c) {
-					retireSubtree(nodes_[i].children[c]);
+		world.completeBuilding(info.target_id);
+		// 将该工地对应任务及其子树需求清零，避免重复采集
+		int build_id = findBuildNode(info);
+		if (build_id >= 0) {
+			nodes_[build_id].produced = nodes_[build_id].demand;
+			nodes_[build_id].allocated = std::max(0, nodes_[build_id].allocated - 1);
+			NodeRange kids = children(build_id);
+			for (size_t c = 0; c < kids.size(); ++c) {
+				retireSubtree(kids[c]);
+			}
+			if (lazy_) {
+				// 惰性模式：退役的子树直接释放，槽位留给之后的展开
+				for (size_t c = 0; c < kids.size(); ++c) releaseSubtree(kids[c]);
+				dead_children_ += static_cast<size_t>(nodes_[build_id].child_count);
+				nodes_[build_id].child_count = 0;
+				pending_[build_id] = 0;
+				if (dead_children_ * 2 > child_idx_.size()) {
+					compactTopology();
+					dead_children_ = 0;
 				}
-				break;
 			}
+			refreshRank(build_id);
 		}
 	} else if (info.type == 2) { // item produced
+		creditProduction(info);
 		if (info.quantity > 0) {
 			world.addItem(info.item_id, info.quantity);
 		}
-	} else if (info.type == 3) { // building spawned/pending
-		addBuildingRequire(info.target_id, info.coord);
+	} else if (info.type == 3) { // building spawned/pending：新订单，类型未知时只登记坐标
+		if (addBuildOrder(info.target_id, info.coord, 1.0, world) < 0) addBuildingRequire(info.target_id, info.coord);
 	}
 }
 
-int TaskTree::buildItemTask(int item_id, int qty, const CraftingSystem& crafting, double weight, int depth) {
-	const CraftingRecipe* recipe = nullptr;
-	const std::map<int, CraftingRecipe>& all = crafting.getAllRecipes();
-	for (std::map<int, CraftingRecipe>::const_iterator it = all.begin(); it != all.end(); ++it) {
-		if (it->second.product_item_id == item_id) {
-			recipe = &(it->second);
-			break;
+void TaskTree::creditProduction(const TaskInfo& info) {
+	if (info.target_id < 0 || static_cast<size_t>(info.target_id) >= nodes_.size()) return;
+	TFNode& n = nodes_[info.target_id];
+	if (n.type == TaskType::Build || n.item_id != info.item_id) return;
+	n.produced = std::min(n.demand, n.produced + info.quantity);
+	n.allocated = std::max(0, n.allocated - info.quantity);
+}
+
+void TaskTree::applyEvents(const std::vector<TaskInfo>& batch, WorldState& world) {
+	std::map<int, int> produced; // item_id -> 本批合计产出
+	for (size_t i = 0; i < batch.size(); ++i) {
+		const TaskInfo& info = batch[i];
+		if (info.type == 2) {
+			creditProduction(info);
+			if (info.quantity > 0) produced[info.item_id] += info.quantity;
+		} else {
+			applyEvent(info, world);
 		}
 	}
+	for (std::map<int, int>::const_iterator it = produced.begin(); it != produced.end(); ++it) {
+		world.addItem(it->first, it->second);
+	}
+}
+
+int TaskTree::addItemNode(int item_id, int qty, const BillOfMaterials& bom, double weight, int depth) {
+	const CraftingRecipe* recipe = bom.recipeFor(item_id);
 
 	TFNode node;
 	node.type = recipe ? TaskType::Craft : TaskType::Gather;
@@ -149,53 +250,302 @@ int TaskTree::buildItemTask(int item_id, int qty, const CraftingSystem& crafting
 		node_weight = pinWeight(depth);
 	}
 	node.priority_weight = node_weight;
-	if (recipe) {
-		node.crafting_id = recipe->crafting_id;
-		int parent = addNode(node);
-		int produced = recipe->quantity_produced > 0 ? recipe->quantity_produced : 1;
-		int batches = (qty + produced - 1) / produced;
-		for (size_t i = 0; i < recipe->materials.size(); ++i) {
-			int mat_qty = recipe->materials[i].quantity_required * batches;
-			int child = buildItemTask(recipe->materials[i].item_id, mat_qty, crafting, node_weight, depth + 1);
-			addEdge(parent, child);
-		}
-		return parent;
-	} else {
-		return addNode(node);
+	if (recipe) node.crafting_id = recipe->crafting_id;
+	TFNodeMeta meta;
+	meta.depth = depth;
+	return addNode(node, meta);
+}
+
+void TaskTree::appendTemplateRows(std::vector<TemplateRow>& rows, int item_id, int qty, int depth, int parent) const {
+	const CraftingRecipe* recipe = bom_.recipeFor(item_id);
+	TemplateRow row;
+	row.type = recipe ? TaskType::Craft : TaskType::Gather;
+	row.item_id = item_id;
+	row.crafting_id = recipe ? recipe->crafting_id : 0;
+	row.demand = qty;
+	row.depth = depth;
+	row.parent = parent;
+	int self = static_cast<int>(rows.size());
+	rows.push_back(row);
+	if (!recipe) return;
+	int produced = recipe->quantity_produced > 0 ? recipe->quantity_produced : 1;
+	int batches = (qty + produced - 1) / produced;
+	for (size_t i = 0; i < recipe->materials.size(); ++i) {
+		appendTemplateRows(rows, recipe->materials[i].item_id, recipe->materials[i].quantity_required * batches, depth + 1, self);
 	}
 }
 
-void TaskTree::buildFromDatabase(const CraftingSystem& crafting, const std::map<int, Building>& buildings, double weight) {
+const std::vector<TaskTree::TemplateRow>& TaskTree::siteTemplate(const Building& b) {
+	std::map<int, std::vector<TemplateRow> >::iterator it = templates_.find(b.building_id);
+	if (it != templates_.end()) return it->second;
+	std::vector<TemplateRow>& rows = templates_[b.building_id];
+	for (size_t mi = 0; mi < b.required_materials.size(); ++mi) {
+		appendTemplateRows(rows, b.required_materials[mi].first, b.required_materials[mi].second, 1, -1);
+	}
+	return rows;
+}
+
+void TaskTree::instantiate(const std::vector<TemplateRow>& rows, int build_id) {
+	// 先序复制：节点 id 与逐层递归展开时相同；权重沿父节点乘手动倍率，置顶节点取大基数+深度
+	std::vector<int> ids(rows.size(), -1);
+	std::vector<double> weight(rows.size(), 1.0);
+	std::vector<std::vector<int> > kids(rows.size());
+	std::vector<int> top;
+	const double build_weight = nodes_[build_id].priority_weight;
+	for (size_t r = 0; r < rows.size(); ++r) {
+		const TemplateRow& row = rows[r];
+		double w = (row.parent < 0 ? build_weight : weight[row.parent]) * lookupWeight(row.item_id);
+		if (isPinned(row.item_id)) w = pinWeight(row.depth);
+		weight[r] = w;
+		TFNode node;
+		node.type = row.type;
+		node.item_id = row.item_id;
+		node.crafting_id = row.crafting_id;
+		node.demand = row.demand;
+		node.priority_weight = w;
+		TFNodeMeta meta;
+		meta.depth = row.depth;
+		ids[r] = addNode(node, meta);
+		(row.parent < 0 ? top : kids[row.parent]).push_back(ids[r]);
+	}
+	for (size_t r = 0; r < rows.size(); ++r) {
+		if (!kids[r].empty()) linkChildren(ids[r], kids[r]);
+	}
+	linkChildren(build_id, top);
+}
+
+int TaskTree::addSite(const TFNode& build, TFNodeMeta meta) {
+	meta.site = static_cast<int>(site_node_.size());
+	int id = addNode(build, meta);
+	site_node_.push_back(id);
+	addBuildingRequire(build.building_id, meta.coord);
+	return id;
+}
+
+void TaskTree::clearGraph() {
 	nodes_.clear();
+	meta_.clear();
+	child_idx_.clear();
 	building_cons_.clear();
+	item_nodes_.clear();
+	building_nodes_.clear();
+	pending_.clear();
+	freed_.clear();
+	free_.clear();
+	dead_children_ = 0;
+	expansions_ = 0;
+	peak_live_ = 0;
+	templates_.clear();
+	site_node_.clear();
+	synced_ = false;
+}
 
+void TaskTree::buildFromDatabase(const CraftingSystem& crafting, const std::map<int, Building>& buildings, double weight) {
+	clearGraph();
+
+	bom_.build(crafting); // 模板、惰性展开与运行时订单沿用
 	for (std::map<int, Building>::const_iterator it = buildings.begin(); it != buildings.end(); ++it) {
 		if (it->first == 256) continue; // skip storage
-		const Building& b = it->second;
-		TFNode build;
-		build.type = TaskType::Build;
-		build.item_id = 10000 + b.building_id;
-		build.building_id = b.building_id;
-		build.demand = 1;
-		build.produced = 0;
-		build.unique_target = true;
-		build.coord = std::make_pair(b.x, b.y);
-		double node_weight = weight * lookupWeight(build.item_id);
-		if (isPinned(build.item_id)) {
-			node_weight = pinWeight(0);
+		placeSite(it->second, std::make_pair(it->second.x, it->second.y), weight);
+	}
+	compactTopology();
+	initRanks(crafting, buildings);
+}
+
+int TaskTree::placeSite(const Building& b, const std::pair<int,int>& coord, double weight) {
+	TFNode build;
+	build.type = TaskType::Build;
+	build.item_id = 10000 + b.building_id;
+	build.building_id = b.building_id;
+	build.demand = 1;
+	build.produced = 0;
+	TFNodeMeta build_meta;
+	build_meta.unique_target = true;
+	build_meta.coord = coord;
+	double node_weight = weight * lookupWeight(build.item_id);
+	if (isPinned(build.item_id)) {
+		node_weight = pinWeight(0);
+	}
+	build.priority_weight = node_weight;
+	int build_id = addSite(build, build_meta);
+	if (lazy_) pending_[build_id] = 1;
+	else instantiate(siteTemplate(b), build_id);
+	return build_id;
+}
+
+std::vector<std::pair<int,int> > TaskTree::directMaterials(int id, const WorldState& world) const {
+	std::vector<std::pair<int,int> > mats;
+	const TFNode& n = nodes_[id];
+	if (n.type == TaskType::Build) {
+		const Building* b = world.getBuilding(n.building_id);
+		if (b) mats = b->required_materials;
+	} else if (n.type == TaskType::Craft) {
+		const CraftingRecipe* recipe = bom_.recipeFor(n.item_id);
+		if (!recipe) return mats;
+		int produced = recipe->quantity_produced > 0 ? recipe->quantity_produced : 1;
+		int batches = (n.demand + produced - 1) / produced;
+		for (size_t i = 0; i < recipe->materials.size(); ++i) {
+			mats.push_back(std::make_pair(recipe->materials[i].item_id, recipe->materials[i].quantity_required * batches));
 		}
-		build.priority_weight = node_weight;
-		int build_id = addNode(build);
-		addBuildingRequire(b.building_id, build.coord);
-		for (size_t mi = 0; mi < b.required_materials.size(); ++mi) {
-			int mat_id = b.required_materials[mi].first;
-			int mat_qty = b.required_materials[mi].second;
-			int child = buildItemTask(mat_id, mat_qty, crafting, node_weight, 1);
-			addEdge(build_id, child);
+	}
+	return mats;
+}
+
+bool TaskTree::materialsCovered(int id, const WorldState& world) const {
+	// 与“子节点全部完成”等价：子节点的需求就是这些数量
+	std::vector<std::pair<int,int> > mats = directMaterials(id, world);
+	for (size_t i = 0; i < mats.size(); ++i) {
+		std::map<int, Item>::const_iterator it = world.getItems().find(mats[i].first);
+		int have = (it != world.getItems().end()) ? it->second.quantity : 0;
+		if (have < mats[i].second) return false;
+	}
+	return true;
+}
+
+void TaskTree::materialize(const WorldState& world) {
+	// 新子节点可能复用扫描位置之前的槽位，故沿工作栈逐层展开到材料已备齐或叶子为止
+	const size_t n = nodes_.size();
+	std::vector<int> work;
+	for (size_t i = 0; i < n; ++i) {
+		if (!pending_[i]) continue;
+		if (nodes_[i].type == TaskType::Build && isCompleted(static_cast<int>(i))) continue;
+		work.push_back(static_cast<int>(i));
+		while (!work.empty()) {
+			int v = work.back();
+			work.pop_back();
+			if (!pending_[v] || materialsCovered(v, world)) continue;
+			expand(v, world);
+			NodeRange kids = children(v);
+			for (size_t c = 0; c < kids.size(); ++c) work.push_back(kids[c]);
 		}
 	}
 }
 
+void TaskTree::expand(int id, const WorldState& world) {
+	pending_[id] = 0;
+	std::vector<std::pair<int,int> > mats = directMaterials(id, world);
+	const double weight = nodes_[id].priority_weight; // addNode 可能使引用失效，先取值
+	const int depth = meta_[id].depth;
+	std::vector<int> kids;
+	for (size_t i = 0; i < mats.size(); ++i) {
+		int kid = addItemNode(mats[i].first, mats[i].second, bom_, weight, depth + 1);
+		if (nodes_[kid].type == TaskType::Craft) pending_[kid] = 1;
+		kids.push_back(kid);
+	}
+	linkChildren(id, kids);
+	for (size_t i = 0; i < kids.size(); ++i) initSubtree(kids[i], world);
+	expansions_++;
+}
+
+void TaskTree::initSubtree(int root, const WorldState& world) {
+	if (rank_cost_.size() < nodes_.size()) {
+		rank_cost_.resize(nodes_.size(), 0);
+		workbench_of_.resize(nodes_.size(), -1);
+	}
+	// 先序：父节点的秩先于子节点确定
+	std::vector<int> work(1, root);
+	std::set<int> benches;
+	while (!work.empty()) {
+		int v = work.back();
+		work.pop_back();
+		if (nodes_[v].type != TaskType::Build) syncItemNode(nodes_[v], world);
+		initNodeCost(v, world.getCraftingSystem(), world.getBuildings());
+		nodes_[v].rank = computeRank(v);
+		if (workbench_of_[v] >= 0) benches.insert(workbench_of_[v]);
+		NodeRange kids = children(v);
+		for (size_t c = 0; c < kids.size(); ++c) work.push_back(kids[c]);
+	}
+	for (std::set<int>::const_iterator it = benches.begin(); it != benches.end(); ++it) refreshRank(*it);
+}
+
+int TaskTree::findBuildNode(const TaskInfo& info) const {
+	int node = siteNode(info.site);
+	if (node >= 0) return nodes_[node].building_id == info.target_id && !isCompleted(node) ? node : -1;
+	// 不带工地 id 的外部事件：在该类建筑的工地中按坐标找
+	const int building_id = info.target_id;
+	const std::pair<int,int>& coord = info.coord;
+	std::map<int, std::vector<int> >::const_iterator idx = building_nodes_.find(building_id);
+	if (idx == building_nodes_.end()) return -1;
+	int fallback = -1;
+	for (size_t k = 0; k < idx->second.size(); ++k) {
+		int id = idx->second[k];
+		if (isCompleted(id)) continue;
+		if (meta_[id].coord == coord) return id;
+		if (fallback < 0) fallback = id; // 外部事件可能不带坐标
+	}
+	return fallback;
+}
+
+int TaskTree::addBuildOrder(int building_type, const std::pair<int,int>& coord, double priority, const WorldState& world) {
+	const Building* b = world.getBuilding(building_type);
+	if (!b) return -1;
+	int build_id = placeSite(*b, coord, priority);
+	initSubtree(build_id, world);
+	return meta_[build_id].site;
+}
+
+bool TaskTree::cancelBuildOrder(int site) {
+	int id = siteNode(site);
+	if (id < 0 || isCompleted(id)) return false;
+	const TFNode& n = nodes_[id];
+	if (n.building_id >= 0 && static_cast<size_t>(n.building_id) < building_cons_.size()) {
+		std::vector<std::pair<int,int> >& lst = building_cons_[n.building_id];
+		std::vector<std::pair<int,int> >::iterator it = std::find(lst.begin(), lst.end(), meta_[id].coord);
+		if (it != lst.end()) lst.erase(it);
+	}
+	releaseSubtree(id);
+	site_node_[site] = -1;
+	if (dead_children_ * 2 > child_idx_.size()) {
+		compactTopology();
+		dead_children_ = 0;
+	}
+	return true;
+}
+
+void TaskTree::releaseSubtree(int id) {
+	TFNode& n = nodes_[id];
+	const int* c = child_idx_.data() + n.child_begin;
+	for (int i = 0; i < n.child_count; ++i) releaseSubtree(c[i]);
+	dead_children_ += static_cast<size_t>(n.child_count);
+	std::map<int, std::vector<int> >& index = n.type == TaskType::Build ? building_nodes_ : item_nodes_;
+	std::map<int, std::vector<int> >::iterator idx = index.find(n.type == TaskType::Build ? n.building_id : n.item_id);
+	int next = -1; // 同类的下一处工地
+	if (idx != index.end()) {
+		idx->second.erase(std::remove(idx->second.begin(), idx->second.end(), id), idx->second.end());
+		if (idx->second.empty()) index.erase(idx);
+		else next = idx->second[0];
+	}
+	std::map<int, std::vector<int> >::iterator users = workbench_users_.find(id);
+	if (users != workbench_users_.end()) {
+		// 撤销的是工作台订单：其使用者改挂同类的下一处工地
+		std::vector<int> moved;
+		moved.swap(users->second);
+		workbench_users_.erase(users);
+		for (size_t k = 0; k < moved.size(); ++k) {
+			workbench_of_[moved[k]] = next;
+			if (next >= 0) workbench_users_[next].push_back(moved[k]);
+		}
+		if (next >= 0) refreshRank(next);
+	}
+	int bench = workbench_of_[id];
+	if (bench >= 0) {
+		std::vector<int>& users = workbench_users_[bench];
+		users.erase(std::remove(users.begin(), users.end(), id), users.end());
+	}
+	TFNode inert;
+	inert.id = id;
+	inert.item_id = -1;
+	inert.demand = 0;
+	nodes_[id] = inert;
+	meta_[id] = TFNodeMeta();
+	rank_cost_[id] = 0;
+	workbench_of_[id] = -1;
+	pending_[id] = 0;
+	freed_[id] = 1;
+	free_.push_back(id);
+	if (bench >= 0) refreshRank(bench);
+}
+
 const double TaskTree::PIN_BASE = 1e6;
 
 bool TaskTree::isCompleted(int id) const {
@@ -209,15 +559,88 @@ void TaskTree::retireSubtree(int id) {
 	n.demand = 0;
 	n.produced = 0;
 	n.allocated = 0;
-	for (size_t i = 0; i < n.children.size(); ++i) {
-		retireSubtree(n.children[i]);
+	n.rank = 0;
+	const int* c = child_idx_.data() + n.child_begin;
+	for (int i = 0; i < n.child_count; ++i) {
+		retireSubtree(c[i]);
+	}
+	if (id < static_cast<int>(workbench_of_.size()) && workbench_of_[id] >= 0) refreshRank(workbench_of_[id]); // 工作台少了一个使用者
+}
+
+void TaskTree::initRanks(const CraftingSystem& crafting, const std::map<int, Building>& buildings) {
+	const size_t n = nodes_.size();
+	rank_cost_.assign(n, 0);
+	workbench_of_.assign(n, -1);
+	workbench_users_.clear();
+	for (size_t i = 0; i < n; ++i) initNodeCost(static_cast<int>(i), crafting, buildings);
+	// 后继先于前驱：父节点 id 更小，工作台的使用者可能在其后，故反复松弛到稳定（无环时至多深度轮）
+	for (size_t i = 0; i < n; ++i) nodes_[i].rank = 0;
+	for (size_t round = 0; round <= n; ++round) {
+		bool changed = false;
+		for (size_t i = 0; i < n; ++i) {
+			int r = computeRank(static_cast<int>(i));
+			if (r != nodes_[i].rank) {
+				nodes_[i].rank = r;
+				changed = true;
+			}
+		}
+		if (!changed) break;
+	}
+}
+
+void TaskTree::initNodeCost(int id, const CraftingSystem& crafting, const std::map<int, Building>& buildings) {
+	const TFNode& node = nodes_[id];
+	rank_cost_[id] = 0;
+	workbench_of_[id] = -1;
+	if (node.type == TaskType::Build) {
+		std::map<int, Building>::const_iterator b = buildings.find(node.building_id);
+		rank_cost_[id] = b != buildings.end() ? std::max(1, b->second.construction_time * 20) : 1;
+	} else if (node.type == TaskType::Craft) {
+		const CraftingRecipe* r = crafting.getRecipe(node.crafting_id);
+		if (!r) return;
+		int out = r->quantity_produced > 0 ? r->quantity_produced : 1;
+		rank_cost_[id] = (node.demand + out - 1) / out * std::max(1, r->production_time * 20);
+		std::map<int, std::vector<int> >::const_iterator wb = building_nodes_.find(r->required_building_id);
+		if (r->required_building_id > 0 && wb != building_nodes_.end() && !wb->second.empty()) {
+			workbench_of_[id] = wb->second[0];
+			workbench_users_[wb->second[0]].push_back(id);
+		}
+	} else {
+		rank_cost_[id] = (node.demand + 9) / 10 * 20; // 每 20 tick 采 10 个
+	}
+}
+
+int TaskTree::computeRank(int id) const {
+	const TFNode& n = nodes_[id];
+	if (isCompleted(id)) return 0;
+	int succ = n.parent >= 0 ? nodes_[n.parent].rank : 0;
+	std::map<int, std::vector<int> >::const_iterator users = workbench_users_.find(id);
+	if (users != workbench_users_.end()) {
+		for (size_t k = 0; k < users->second.size(); ++k) succ = std::max(succ, nodes_[users->second[k]].rank);
+	}
+	return rank_cost_[id] + succ;
+}
+
+void TaskTree::refreshRank(int id) {
+	if (rank_cost_.size() != nodes_.size()) return; // 尚未 initRanks
+	// 某节点的秩只影响依赖它的前驱：其子节点，以及（若为 Craft）它所需的工作台
+	std::vector<int> work(1, id);
+	size_t budget = nodes_.size() * 4 + 4;
+	while (!work.empty() && budget-- > 0) {
+		int v = work.back();
+		work.pop_back();
+		int r = computeRank(v);
+		if (r == nodes_[v].rank) continue;
+		nodes_[v].rank = r;
+		const int* c = child_idx_.data() + nodes_[v].child_begin;
+		for (int i = 0; i < nodes_[v].child_count; ++i) work.push_back(c[i]);
+		if (workbench_of_[v] >= 0) work.push_back(workbench_of_[v]);
 	}
 }
 
 int TaskTree::remainingNeed(const TFNode& n, const WorldState& world) const {
 	if (n.type == TaskType::Build) {
-		const Building* b = world.getBuilding(n.building_id);
-		int done = (b && b->isCompleted) ? n.demand : 0;
+		int done = n.produced >= n.demand ? n.demand : 0; // 按工地记完成，同类建筑可有多处
 		int rem = n.demand - done - n.allocated;
 		return rem < 0 ? 0 : rem;
 	}
@@ -230,8 +653,7 @@ int TaskTree::remainingNeed(const TFNode& n, const WorldState& world) const {
 
 int TaskTree::remainingNeedRaw(const TFNode& n, const WorldState& world) const {
 	if (n.type == TaskType::Build) {
-		const Building* b = world.getBuilding(n.building_id);
-		int done = (b && b->isCompleted) ? n.demand : 0;
+		int done = n.produced >= n.demand ? n.demand : 0;
 		int rem = n.demand - done;
 		return rem < 0 ? 0 : rem;
 	}
@@ -1,7 +1,6 @@
 #include "../includes/WorldState.hpp"
 #include "../includes/DatabaseInitializer.hpp"
 #include <cstdlib>
-#include <random>
 
 WorldState::WorldState(DatabaseManager& db) : db_(db) {
 	items = db.item_database;
@@ -15,7 +14,16 @@ WorldState::WorldState(DatabaseManager& db) : db_(db) {
 }
 
 void WorldState::CreateRandomWorld(int world_width, int world_height) {
-	static std::mt19937 rng(114514); // 固定种子，便于复现；后续可调整为参数
+	static std::mt19937 rng(114514); // 固定种子，便于复现；多次调用依次取后续布局
+	placeRandom(world_width, world_height, rng);
+}
+
+void WorldState::CreateRandomWorld(int world_width, int world_height, unsigned seed) {
+	std::mt19937 rng(seed);
+	placeRandom(world_width, world_height, rng);
+}
+
+void WorldState::placeRandom(int world_width, int world_height, std::mt19937& rng) {
 	std::uniform_int_distribution<int> dist_x(0, world_width - 1);
 	std::uniform_int_distribution<int> dist_y(0, world_height - 1);
 
@@ -76,6 +84,7 @@ void WorldState::CreateRandomWorld(int world_width, int world_height) {
 				rp.resource_item_id = it->first;
 				rp.remaining_resource = 1000;
 				rp.generation_rate = 2;
+				rp.capacity = rp.remaining_resource;
 				rp.x = x; rp.y = y;
 				resource_points[rp.resource_point_id] = rp;
 				break;
@@ -106,13 +115,16 @@ const Item* WorldState::getItemMeta(int id) const {
 
 void WorldState::addItem(int item_id, int qty) {
 	items[item_id].quantity += qty;
+	if (qty != 0) dirty_items_.insert(item_id);
 }
 
 void WorldState::removeItem(int item_id, int qty) {
 	std::map<int, Item>::iterator it = items.find(item_id);
 	if (it == items.end()) return;
+	int before = it->second.quantity;
 	if (it->second.quantity < qty) it->second.quantity = 0;
 	else it->second.quantity -= qty;
+	if (it->second.quantity != before) dirty_items_.insert(item_id);
 }
 
 bool WorldState::hasEnoughItems(const std::vector<CraftingMaterial>& mats) const {
@@ -122,3 +134,38 @@ bool WorldState::hasEnoughItems(const std::vector<CraftingMaterial>& mats) const
 	}
 	return true;
 }
+
+void WorldState::completeBuilding(int building_id) {
+	Building* b = getBuilding(building_id);
+	if (!b || b->isCompleted) return;
+	b->completeConstruction();
+	dirty_buildings_.insert(building_id);
+}
+
+int WorldState::harvestResource(ResourcePoint& rp, int amount) {
+	rp.settle(tick_, regen_period_);
+	int take = amount < rp.remaining_resource ? amount : rp.remaining_resource;
+	if (take <= 0) return 0;
+	rp.remaining_resource -= take;
+	if (rp.remaining_resource <= 0 && regen_period_ > 0 && rp.generation_rate > 0 && rp.capacity > 0) {
+		refills_.push(std::make_pair(rp.last_tick + regen_period_, rp.resource_point_id));
+	}
+	return take;
+}
+
+bool WorldState::popRefilled(int& item_id) {
+	while (!refills_.empty() && refills_.top().first <= tick_) {
+		const ResourcePoint* rp = getResourcePoint(refills_.top().second);
+		refills_.pop();
+		if (rp && resourceAvailable(*rp) > 0) {
+			item_id = rp->resource_item_id;
+			return true;
+		}
+	}
+	return false;
+}
+
+void WorldState::clearDirty() {
+	dirty_items_.clear();
+	dirty_buildings_.clear();
+}
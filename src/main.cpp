@@ -10,8 +10,99 @@
 #include "DatabaseInitializer.hpp"
 #include "WorldState.hpp"
 #include "WorkerInit.hpp"
+#include "Forecaster.hpp"
+#include "SchedulingService.hpp"
+#include "ShardedSimulator.hpp"
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#ifdef TF_SHIPPED_CONTENT
+#include "ShippedContent.hpp"
+#endif
+
+static SchedulingService* g_service = nullptr;
+
+static void onStopSignal(int) {
+	if (g_service) g_service->stop();
+}
+
+int main(int argc, char** argv) {
+	// --forecast N：只输出 N 名工人下各建筑的解析式完工预测，不跑模拟
+	// --serve PATH [--workers N] [--window-us U]：以调度服务方式运行，直到 SIGINT/SIGTERM
+	// --shards K [--shard-agents N] [--epoch T] [--shard-procs]：K 个 2000x2000 区域拼成的大地图分片模拟
+	// --cbba-groups G [--cbba-topology full|ring|line|star] [--cbba-loss P] [--cbba-delay D]：去中心化竞价
+	// --coro：agent 任务以协程执行（事件/计时唤醒），代替逐 tick 轮询
+	// --orders N：开局后随机追加 N 个运行时建造订单（类型、坐标随机，固定种子）
+	// --lazy-tree：任务树按需展开（材料不足时才生成子节点，建成后释放子树）；与 --forecast 同用时忽略
+	// --regen T：资源点每 T 个 tick 恢复 generation_rate（至多初始存量），默认不再生
+	// --rp-slots N：每个资源点可同时采集的人数（默认 1）
+	// --carry N：工人随身搬运，每人至多 N 件，产出送到最近的仓库或消费地才入库（默认 0：产出直接入库）
+	// --assign-budget-us U [--assign-audit]：竞价限时 U 微秒（到期返回已有分配，余下的下次继续）；audit 另跑不限时版本比较总分
+	int forecast_workers = 0;
+	int shard_count = 0;
+	int shard_agents = 3;
+	int shard_epoch = 20;
+	bool shard_procs = false;
+	bool coroutine_agents = false;
+	bool lazy_tree = false;
+	int extra_orders = 0;
+	int regen_period = 0;
+	int rp_slots = 1;
+	int carry_capacity = 0;
+	long long assign_budget_us = 0;
+	bool assign_audit = false;
+	ConsensusConfig consensus;
+	std::string serve_path;
+	int service_workers = 4;
+	int batch_window_us = 1000;
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--forecast") == 0 && i + 1 < argc) {
+			forecast_workers = std::max(1, std::atoi(argv[++i]));
+		} else if (std::strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+			serve_path = argv[++i];
+		} else if (std::strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+			service_workers = std::max(0, std::atoi(argv[++i]));
+		} else if (std::strcmp(argv[i], "--window-us") == 0 && i + 1 < argc) {
+			batch_window_us = std::max(0, std::atoi(argv[++i]));
+		} else if (std::strcmp(argv[i], "--shards") == 0 && i + 1 < argc) {
+			shard_count = std::max(1, std::atoi(argv[++i]));
+		} else if (std::strcmp(argv[i], "--shard-agents") == 0 && i + 1 < argc) {
+			shard_agents = std::max(1, std::atoi(argv[++i]));
+		} else if (std::strcmp(argv[i], "--epoch") == 0 && i + 1 < argc) {
+			shard_epoch = std::max(1, std::atoi(argv[++i]));
+		} else if (std::strcmp(argv[i], "--shard-procs") == 0) {
+			shard_procs = true;
+		} else if (std::strcmp(argv[i], "--cbba-groups") == 0 && i + 1 < argc) {
+			consensus.groups = std::max(1, std::atoi(argv[++i]));
+		} else if (std::strcmp(argv[i], "--cbba-topology") == 0 && i + 1 < argc) {
+			if (!parseConsensusTopology(argv[++i], consensus.topology)) {
+				std::cerr << "未知拓扑: " << argv[i] << "（可选 full/ring/line/star）" << std::endl;
+				return 1;
+			}
+		} else if (std::strcmp(argv[i], "--cbba-loss") == 0 && i + 1 < argc) {
+			consensus.loss = std::min(0.95, std::max(0.0, std::atof(argv[++i])));
+		} else if (std::strcmp(argv[i], "--cbba-delay") == 0 && i + 1 < argc) {
+			consensus.max_delay = std::max(0, std::atoi(argv[++i]));
+		} else if (std::strcmp(argv[i], "--coro") == 0) {
+			coroutine_agents = true;
+		} else if (std::strcmp(argv[i], "--lazy-tree") == 0) {
+			lazy_tree = true;
+		} else if (std::strcmp(argv[i], "--orders") == 0 && i + 1 < argc) {
+			extra_orders = std::max(0, std::atoi(argv[++i]));
+		} else if (std::strcmp(argv[i], "--regen") == 0 && i + 1 < argc) {
+			regen_period = std::max(0, std::atoi(argv[++i]));
+		} else if (std::strcmp(argv[i], "--rp-slots") == 0 && i + 1 < argc) {
+			rp_slots = std::max(1, std::atoi(argv[++i]));
+		} else if (std::strcmp(argv[i], "--carry") == 0 && i + 1 < argc) {
+			carry_capacity = std::max(0, std::atoi(argv[++i]));
+		} else if (std::strcmp(argv[i], "--assign-budget-us") == 0 && i + 1 < argc) {
+			assign_budget_us = std::max(0LL, std::atoll(argv[++i]));
+		} else if (std::strcmp(argv[i], "--assign-audit") == 0) {
+			assign_audit = true;
+		}
+	}
 
-int main() {
 	DatabaseManager db;
 	const char* paths[] = {"resources/game_data.db", "../resources/game_data.db"};
 	bool connected = false;
@@ -46,6 +137,23 @@ int main() {
 			}
 		}
 	}
+	// 可选估价/交易参数：resources/scheduler_policy.txt，每行 "参数名 值"（PolicyTuner 的输出格式）
+	SchedulerPolicy policy;
+	{
+		std::ifstream fin("resources/scheduler_policy.txt");
+		if (fin.is_open()) {
+			std::string line;
+			while (std::getline(fin, line)) {
+				if (line.empty() || line[0] == '#') continue;
+				std::istringstream iss(line);
+				std::string name;
+				double value;
+				if (iss >> name >> value && !setPolicyParam(policy, name, value)) {
+					std::cerr << "未知策略参数: " << name << std::endl;
+				}
+			}
+		}
+	}
 	{
 		std::ifstream fin("resources/pinned_items.txt");
 		if (fin.is_open()) {
@@ -61,8 +169,45 @@ int main() {
 		}
 	}
 
+	if (!serve_path.empty()) {
+		SchedulingService service(db, service_workers, batch_window_us);
+		if (!service.listen(serve_path)) return 1;
+		g_service = &service;
+		std::signal(SIGINT, onStopSignal);
+		std::signal(SIGTERM, onStopSignal);
+		std::cout << "Serving on " << serve_path << " (workers=" << service_workers
+		          << ", window=" << batch_window_us << "us)" << std::endl;
+		service.serve();
+		g_service = nullptr;
+		LatencySummary l = service.latency();
+		std::cout << "Requests: " << l.count << " p50=" << l.p50 << "us p90=" << l.p90
+		          << "us p99=" << l.p99 << "us max=" << l.max << "us" << std::endl;
+		return 0;
+	}
+
+	if (shard_count > 0) {
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		ShardedSimulator sharded(db, shard_count, 2000, 2000, shard_agents);
+		sharded.setEpoch(shard_epoch);
+		sharded.setProcessMode(shard_procs);
+		ShardStats st = sharded.run(24000);
+		long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+		std::cout << "Sharded run: " << shard_count << " shards (" << (shard_procs ? "processes" : "threads")
+		          << "), " << st.ticks << " ticks, " << st.epochs << " epochs, " << ms << " ms" << std::endl;
+		for (size_t i = 0; i < st.builds.size(); ++i) {
+			std::cout << "  S" << st.builds[i].shard << " B" << st.builds[i].building_id
+			          << " built at tick " << st.builds[i].tick << std::endl;
+		}
+		long long ledger_total = 0;
+		for (std::map<int, int>::const_iterator it = st.ledger.begin(); it != st.ledger.end(); ++it) ledger_total += it->second;
+		std::cout << "  items moved between shards: " << st.items_moved << ", agent handoffs: " << st.handoffs
+		          << ", left in ledger: " << ledger_total << std::endl;
+		return 0;
+	}
+
 	WorldState world(db);
 	world.CreateRandomWorld(2000, 2000);
+	world.setResourceRegen(regen_period);
 	Scheduler scheduler(world);
 	TaskTree task_tree;
 	if (priority_weights.empty()) {
@@ -81,14 +226,83 @@ int main() {
 		task_tree.setPinnedItems(pinned_items);
 	}
 
-	// 从数据库数据生成任务图
+	// 从数据库数据生成任务图（TF_SHIPPED_CONTENT 时直接用编译期内容表展开）
+#ifdef TF_SHIPPED_CONTENT
+	task_tree.buildFromContent<ShippedContent>(world.getBuildings());
+#else
+	task_tree.setLazyExpansion(lazy_tree && forecast_workers == 0); // 预测要遍历完整的子树
 	task_tree.buildFromDatabase(world.getCraftingSystem(), world.getBuildings());
+#endif
+
+	if (forecast_workers > 0) {
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		Forecaster forecaster(world, task_tree);
+		std::vector<BuildForecast> per_build = forecaster.forecast(forecast_workers);
+		BuildForecast all = forecaster.forecastAll(forecast_workers);
+		long long us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - t0).count();
+		std::cout << "Forecast with " << forecast_workers << " workers (ticks, 20 tick/s):" << std::endl;
+		for (size_t i = 0; i < per_build.size(); ++i) {
+			const BuildForecast& f = per_build[i];
+			const Building* b = world.getBuilding(f.building_id);
+			std::cout << "  B" << f.building_id << " " << (b ? b->building_name : "?")
+			          << ": critical_path=" << f.critical_path << " work=" << f.work
+			          << " estimate=[" << f.lower_bound << ", " << f.upper_bound << "]" << std::endl;
+		}
+		std::cout << "  All: critical_path=" << all.critical_path << " work=" << all.work
+		          << " estimate=[" << all.lower_bound << ", " << all.upper_bound << "]" << std::endl;
+		std::cout << "  (" << us << " us)" << std::endl;
+		return 0;
+	}
 
 	// 创建 NPC（默认参数，后续修改只需调整 init 函数）
 	std::vector<Agent*> agents = initDefaultWorkers(3, &world.getCraftingSystem());
 
+	scheduler.setPolicy(policy);
+	scheduler.setConsensus(consensus);
+	scheduler.setAnytimeBudget(assign_budget_us, assign_audit);
 	Simulator sim(world, task_tree, scheduler, agents);
-	sim.run(24000); // 1200 秒（20 tick/s）
+	sim.setCoroutineAgents(coroutine_agents);
+	sim.setResourceSlots(rp_slots);
+	sim.setCarryCapacity(carry_capacity);
+	if (extra_orders > 0) {
+		if (!sim.begin()) return 1;
+		std::vector<int> types;
+		for (std::map<int, Building>::const_iterator it = world.getBuildings().begin(); it != world.getBuildings().end(); ++it) {
+			if (it->first != 256) types.push_back(it->first);
+		}
+		std::mt19937 order_rng(2025);
+		std::uniform_int_distribution<int> pos(0, 1999);
+		for (int i = 0; i < extra_orders && !types.empty(); ++i) {
+			sim.addBuildOrder(types[order_rng() % types.size()], pos(order_rng), pos(order_rng));
+		}
+		sim.step(24000);
+		sim.finish();
+	} else {
+		sim.run(24000); // 1200 秒（20 tick/s）
+	}
+	if (consensus.groups > 0) {
+		const ConsensusStats& cs = scheduler.consensusStats();
+		std::cout << "[CBBA] runs=" << cs.runs << " rounds_avg=" << (cs.runs > 0 ? static_cast<double>(cs.rounds_total) / cs.runs : 0.0)
+		          << " rounds_max=" << cs.rounds_max << " messages=" << cs.messages << " entries=" << cs.entries
+		          << " lost=" << cs.lost << " unconverged=" << cs.unconverged
+		          << " us_avg=" << (cs.runs > 0 ? cs.micros_total / cs.runs : 0) << std::endl;
+	}
+	if (assign_budget_us > 0 && consensus.groups <= 0) {
+		const AnytimeStats& as = scheduler.anytimeStats();
+		std::cout << "[Anytime] budget=" << assign_budget_us << "us runs=" << as.runs << " truncated=" << as.truncated
+		          << " deferred=" << as.deferred << " cached_bids=" << as.cached_bids
+		          << " us_avg=" << (as.runs > 0 ? as.micros_total / as.runs : 0) << " us_max=" << as.micros_max;
+		if (assign_audit) {
+			double loss = as.score_full > 0.0 ? 1.0 - as.score / as.score_full : 0.0;
+			std::cout << " audits=" << as.audits << " score=" << as.score << " score_full=" << as.score_full
+			          << " loss=" << loss * 100.0 << "%";
+		}
+		std::cout << std::endl;
+	}
+	if (task_tree.lazyExpansion()) {
+		std::cout << "[Tree] expansions=" << task_tree.expansionCount() << " live_nodes=" << task_tree.liveNodeCount()
+		          << " peak_nodes=" << task_tree.peakNodeCount() << " slots=" << task_tree.nodes().size() << std::endl;
+	}
 
 	for (Agent* ag : agents) delete ag;
 	return 0;
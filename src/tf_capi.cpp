@@ -0,0 +1,206 @@
+#include "../includes/tf_capi.h"
+#include "../includes/DatabaseInitializer.hpp"
+#include "../includes/WorldState.hpp"
+#include "../includes/TaskTree.hpp"
+#include "../includes/Scheduler.hpp"
+#include "../includes/Simulator.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+struct tf_sim {
+	DatabaseManager db;
+	std::unique_ptr<WorldState> world;
+	TaskTree tree;
+	std::unique_ptr<Scheduler> scheduler;
+	std::vector<Agent*> agents;
+	std::unique_ptr<Simulator> sim;
+	bool started = false;
+	std::string log_path;
+	tf_event_callback callback = nullptr;
+	void* user_data = nullptr;
+
+	~tf_sim() {
+		if (sim && started) sim->finish();
+		sim.reset();
+		for (size_t i = 0; i < agents.size(); ++i) delete agents[i];
+	}
+};
+
+extern "C" {
+
+int tf_capi_version(void) {
+	return TF_CAPI_VERSION;
+}
+
+tf_sim* tf_create(const char* db_path, int world_width, int world_height) {
+	if (!db_path) return nullptr;
+	try {
+		std::unique_ptr<tf_sim> s(new tf_sim());
+		if (!s->db.connect(db_path)) return nullptr;
+		s->db.enable_performance_mode();
+		if (!s->db.initialize_all_data()) return nullptr;
+		s->world.reset(new WorldState(s->db));
+		s->world->CreateRandomWorld(world_width > 0 ? world_width : 2000, world_height > 0 ? world_height : 2000);
+		s->tree.buildFromDatabase(s->world->getCraftingSystem(), s->world->getBuildings());
+		s->scheduler.reset(new Scheduler(*s->world));
+		s->sim.reset(new Simulator(*s->world, s->tree, *s->scheduler, s->agents));
+		s->sim->setLogPath(std::string());
+		tf_sim* raw = s.get();
+		s->sim->setEventCallback([raw](const SimEvent& ev) {
+			if (!raw->callback) return;
+			tf_event out = {ev.tick, ev.type, ev.agent, ev.target_id, ev.quantity};
+			raw->callback(&out, raw->user_data);
+		});
+		return s.release();
+	} catch (...) {
+		return nullptr;
+	}
+}
+
+void tf_destroy(tf_sim* sim) {
+	delete sim;
+}
+
+int tf_add_agent(tf_sim* sim, int x, int y) {
+	if (!sim) return -1;
+	try {
+		int n = static_cast<int>(sim->agents.size());
+		sim->agents.push_back(new Agent("Worker_" + std::to_string(n + 1), "Worker", 100, x, y, &sim->world->getCraftingSystem()));
+		return n;
+	} catch (...) {
+		return -1;
+	}
+}
+
+int tf_add_build_order(tf_sim* sim, int building_type, int x, int y, double priority) {
+	if (!sim) return -1;
+	try {
+		return sim->sim->addBuildOrder(building_type, x, y, priority > 0.0 ? priority : 1.0);
+	} catch (...) {
+		return -1;
+	}
+}
+
+int tf_cancel_build_order(tf_sim* sim, int order) {
+	if (!sim) return 0;
+	return sim->sim->cancelBuildOrder(order) ? 1 : 0;
+}
+
+int tf_order_completed(const tf_sim* sim, int order) {
+	if (!sim) return -1;
+	int node = sim->tree.siteNode(order);
+	if (node < 0) return -1;
+	return sim->tree.isCompleted(node, *sim->world) ? 1 : 0;
+}
+
+void tf_set_log(tf_sim* sim, const char* path) {
+	if (!sim || sim->started) return;
+	sim->log_path = path ? path : "";
+	sim->sim->setLogPath(sim->log_path);
+}
+
+void tf_set_event_callback(tf_sim* sim, tf_event_callback cb, void* user_data) {
+	if (!sim) return;
+	sim->callback = cb;
+	sim->user_data = user_data;
+}
+
+void tf_set_resource_regen(tf_sim* sim, int period) {
+	if (!sim) return;
+	sim->world->setResourceRegen(period);
+}
+
+int tf_set_resource_slots(tf_sim* sim, int resource_point_id, int slots) {
+	if (!sim) return 0;
+	if (resource_point_id < 0) {
+		sim->sim->setResourceSlots(slots);
+		return 1;
+	}
+	return sim->sim->resourceSlots().setCapacity(resource_point_id, slots) ? 1 : 0;
+}
+
+void tf_set_carry_capacity(tf_sim* sim, int capacity) {
+	if (!sim) return;
+	sim->sim->setCarryCapacity(capacity);
+}
+
+void tf_set_assign_budget(tf_sim* sim, long long micros) {
+	if (!sim) return;
+	sim->scheduler->setAnytimeBudget(micros);
+}
+
+int tf_step(tf_sim* sim, int ticks) {
+	if (!sim) return -1;
+	try {
+		if (!sim->started) {
+			if (!sim->sim->begin()) return -1;
+			sim->started = true;
+		}
+		if (ticks > 0) sim->sim->step(ticks);
+		return sim->sim->tick();
+	} catch (...) {
+		return -1;
+	}
+}
+
+int tf_current_tick(const tf_sim* sim) {
+	return sim ? sim->sim->tick() : -1;
+}
+
+int tf_agent_count(const tf_sim* sim) {
+	return sim ? static_cast<int>(sim->agents.size()) : 0;
+}
+
+int tf_get_agent_positions(const tf_sim* sim, tf_position* out, int capacity) {
+	if (!sim || !out || capacity <= 0) return 0;
+	int n = static_cast<int>(sim->agents.size());
+	if (n > capacity) n = capacity;
+	for (int i = 0; i < n; ++i) {
+		out[i].x = sim->agents[i]->x;
+		out[i].y = sim->agents[i]->y;
+	}
+	return n;
+}
+
+int tf_get_agent_tasks(const tf_sim* sim, tf_task* out, int capacity) {
+	if (!sim || !out || capacity <= 0) return 0;
+	int n = static_cast<int>(sim->agents.size());
+	if (n > capacity) n = capacity;
+	for (int i = 0; i < n; ++i) {
+		int tid = sim->sim->currentTask(static_cast<size_t>(i));
+		out[i].node_id = tid;
+		if (tid < 0) {
+			out[i].type = TF_TASK_IDLE;
+			out[i].target_id = -1;
+			continue;
+		}
+		const TFNode& node = sim->tree.get(tid);
+		out[i].type = static_cast<int>(node.type);
+		out[i].target_id = node.type == TaskType::Build ? node.building_id : node.item_id;
+	}
+	return n;
+}
+
+int tf_building_completed(const tf_sim* sim, int building_id) {
+	if (!sim) return -1;
+	const Building* b = static_cast<const WorldState&>(*sim->world).getBuilding(building_id);
+	if (!b) return -1;
+	return b->isCompleted ? 1 : 0;
+}
+
+int tf_item_quantity(const tf_sim* sim, int item_id) {
+	if (!sim) return 0;
+	const std::map<int, Item>& items = sim->world->getItems();
+	std::map<int, Item>::const_iterator it = items.find(item_id);
+	return it != items.end() ? it->second.quantity : 0;
+}
+
+int tf_resource_remaining(const tf_sim* sim, int resource_point_id) {
+	if (!sim) return -1;
+	const std::map<int, ResourcePoint>& points = sim->world->getResourcePoints();
+	std::map<int, ResourcePoint>::const_iterator it = points.find(resource_point_id);
+	return it != points.end() ? sim->world->resourceAvailable(it->second) : -1;
+}
+
+} // extern "C"
@@ -0,0 +1,165 @@
+// ContentGen: 读取 game_data.db，生成编译期内容表 ShippedContent.hpp
+// 用法：ContentGen <game_data.db> <output.hpp>
+#include "DatabaseInitializer.hpp"
+#include "BillOfMaterials.hpp"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct DagRow {
+	int parent;
+	int depth;
+	int type;
+	int item_id;
+	int crafting_id;
+	int building_id;
+	int demand;
+};
+
+// 与 TaskTree::buildItemTask 共用 BillOfMaterials 的选取规则：crafting_id 最小的那条产出该物品的配方
+void expand(const BillOfMaterials& bom, int item_id, int qty, int parent, int depth, std::vector<DagRow>& out) {
+	const CraftingRecipe* r = bom.recipeFor(item_id);
+	DagRow row = {parent, depth, r ? 1 : 0, item_id, r ? r->crafting_id : 0, 0, qty};
+	int self = static_cast<int>(out.size());
+	out.push_back(row);
+	if (!r) return;
+	int produced = r->quantity_produced > 0 ? r->quantity_produced : 1;
+	int batches = (qty + produced - 1) / produced;
+	for (size_t i = 0; i < r->materials.size(); ++i) {
+		expand(bom, r->materials[i].item_id, r->materials[i].quantity_required * batches, self, depth + 1, out);
+	}
+}
+
+std::string quoted(const std::string& s) {
+	std::string q = "\"";
+	for (size_t i = 0; i < s.size(); ++i) {
+		if (s[i] == '"' || s[i] == '\\') q += '\\';
+		q += s[i];
+	}
+	return q + "\"";
+}
+
+void writeMaterials(std::ostream& out, const std::vector<std::pair<int,int> >& mats, size_t width) {
+	out << "{";
+	for (size_t i = 0; i < width; ++i) {
+		if (i > 0) out << ", ";
+		if (i < mats.size()) out << "{" << mats[i].first << ", " << mats[i].second << "}";
+		else out << "{0, 0}";
+	}
+	out << "}";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		std::cerr << "usage: ContentGen <game_data.db> <output.hpp>" << std::endl;
+		return 1;
+	}
+	DatabaseManager db;
+	if (!db.connect(argv[1]) || !db.initialize_all_data()) {
+		std::cerr << "ContentGen: failed to load " << argv[1] << std::endl;
+		return 1;
+	}
+	std::map<int, CraftingRecipe> recipes;
+	std::vector<int> ids = db.get_all_recipe_ids();
+	for (size_t i = 0; i < ids.size(); ++i) recipes[ids[i]] = db.get_recipe_by_id(ids[i]);
+
+	size_t max_mats = 1;
+	int max_item = 0;
+	for (std::map<int, CraftingRecipe>::const_iterator it = recipes.begin(); it != recipes.end(); ++it) {
+		max_mats = std::max(max_mats, it->second.materials.size());
+		max_item = std::max(max_item, it->second.product_item_id);
+	}
+	for (std::map<int, Item>::const_iterator it = db.item_database.begin(); it != db.item_database.end(); ++it) {
+		if (it->first < 10000) max_item = std::max(max_item, it->first);
+	}
+	size_t max_bmats = 1;
+	for (std::map<int, Building>::const_iterator it = db.building_database.begin(); it != db.building_database.end(); ++it) {
+		max_bmats = std::max(max_bmats, it->second.required_materials.size());
+	}
+
+	std::vector<int> by_product(max_item + 1, -1);
+	int index = 0;
+	for (std::map<int, CraftingRecipe>::const_iterator it = recipes.begin(); it != recipes.end(); ++it, ++index) {
+		int pid = it->second.product_item_id;
+		if (pid >= 0 && pid <= max_item && by_product[pid] < 0) by_product[pid] = index;
+	}
+
+	CraftingSystem crafting;
+	for (std::map<int, CraftingRecipe>::const_iterator it = recipes.begin(); it != recipes.end(); ++it) crafting.addRecipe(it->second);
+	const BillOfMaterials bom(crafting);
+	std::vector<DagRow> dag;
+	for (std::map<int, Building>::const_iterator it = db.building_database.begin(); it != db.building_database.end(); ++it) {
+		if (it->first == 256) continue; // skip storage
+		const Building& b = it->second;
+		int root = static_cast<int>(dag.size());
+		DagRow row = {-1, 0, 2, 10000 + b.building_id, 0, b.building_id, 1};
+		dag.push_back(row);
+		for (size_t mi = 0; mi < b.required_materials.size(); ++mi) {
+			expand(bom, b.required_materials[mi].first, b.required_materials[mi].second, root, 1, dag);
+		}
+	}
+
+	std::ofstream out(argv[2]);
+	if (!out.is_open()) {
+		std::cerr << "ContentGen: cannot write " << argv[2] << std::endl;
+		return 1;
+	}
+	out << "// Generated by ContentGen from game_data.db. Do not edit.\n"
+	    << "#ifndef TASKFRAMEWORK_SHIPPEDCONTENT_HPP\n#define TASKFRAMEWORK_SHIPPEDCONTENT_HPP\n\n"
+	    << "#include \"StaticContent.hpp\"\n\n"
+	    << "struct ShippedContent {\n"
+	    << "\tstatic constexpr int kMaxMaterials = " << max_mats << ";\n"
+	    << "\tstatic constexpr int kMaxBuildingMaterials = " << max_bmats << ";\n"
+	    << "\tstatic constexpr int kMaxItemId = " << max_item << ";\n";
+
+	out << "\tstatic constexpr int kItemCount = " << db.item_database.size() << ";\n"
+	    << "\tstatic constexpr StaticItem items[kItemCount] = {\n";
+	for (std::map<int, Item>::const_iterator it = db.item_database.begin(); it != db.item_database.end(); ++it) {
+		out << "\t\t{" << it->first << ", " << quoted(it->second.name) << ", " << it->second.required_building_id
+		    << ", " << (it->second.is_resource ? "true" : "false") << "},\n";
+	}
+	out << "\t};\n";
+
+	out << "\tstatic constexpr int kRecipeCount = " << recipes.size() << ";\n"
+	    << "\tstatic constexpr StaticRecipe<kMaxMaterials> recipes[kRecipeCount] = {\n";
+	for (std::map<int, CraftingRecipe>::const_iterator it = recipes.begin(); it != recipes.end(); ++it) {
+		const CraftingRecipe& r = it->second;
+		std::vector<std::pair<int,int> > mats;
+		for (size_t i = 0; i < r.materials.size(); ++i) mats.push_back(std::make_pair(r.materials[i].item_id, r.materials[i].quantity_required));
+		out << "\t\t{" << r.crafting_id << ", " << r.product_item_id << ", " << r.quantity_produced << ", "
+		    << r.production_time << ", " << r.required_building_id << ", ";
+		writeMaterials(out, mats, max_mats);
+		out << "},\n";
+	}
+	out << "\t};\n";
+
+	out << "\tstatic constexpr int recipe_by_product[kMaxItemId + 1] = {";
+	for (size_t i = 0; i < by_product.size(); ++i) out << (i ? ", " : "") << by_product[i];
+	out << "};\n";
+
+	out << "\tstatic constexpr int kBuildingCount = " << db.building_database.size() << ";\n"
+	    << "\tstatic constexpr StaticBuilding<kMaxBuildingMaterials> buildings[kBuildingCount] = {\n";
+	for (std::map<int, Building>::const_iterator it = db.building_database.begin(); it != db.building_database.end(); ++it) {
+		out << "\t\t{" << it->first << ", " << quoted(it->second.building_name) << ", " << it->second.construction_time << ", ";
+		writeMaterials(out, it->second.required_materials, max_bmats);
+		out << "},\n";
+	}
+	out << "\t};\n";
+
+	out << "\tstatic constexpr int kDagSize = " << dag.size() << ";\n"
+	    << "\tstatic constexpr StaticDagNode dag[kDagSize] = {\n";
+	for (size_t i = 0; i < dag.size(); ++i) {
+		const DagRow& d = dag[i];
+		out << "\t\t{" << d.parent << ", " << d.depth << ", " << d.type << ", " << d.item_id << ", "
+		    << d.crafting_id << ", " << d.building_id << ", " << d.demand << "},\n";
+	}
+	out << "\t};\n};\n\n#endif\n";
+	return 0;
+}
@@ -0,0 +1,217 @@
+// PolicyTuner: 在无头模拟中为 SchedulerPolicy（估价与交易参数）做并行随机搜索
+// 用法：PolicyTuner [rounds=3] [samples=12] [seeds=3] [threads=硬件线程数] [workers=3] [horizon=24000]
+// 先评估默认参数作为基线；每轮在两个目标各自的当前最优附近按对数正态扰动生成 samples 组候选（各占一半），
+// 每组候选在 seeds 个布局（种子 114514 起，第一个与 TaskFramework 默认布局相同）上各跑一次完整模拟，
+// 任务分给线程池；轮间扰动幅度减半。结束时按两个目标各输出一份 resources/scheduler_policy.txt 格式的参数：
+//   makespan：全部建筑建成的 tick（未建完记 horizon + 每缺一座 horizon / 建筑数），越小越好
+//   throughput：horizon 内平均已建成的建筑数，sum((horizon - 建成 tick) / horizon)，越大越好
+// 有 resources/priority_weights.txt 时按其权重建树（与 TaskFramework 相同的格式），否则权重全为 1。
+#include "DatabaseInitializer.hpp"
+#include "Scheduler.hpp"
+#include "Simulator.hpp"
+#include "TaskTree.hpp"
+#include "WorkerInit.hpp"
+#include "WorldState.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Outcome {
+	double makespan = 0.0;
+	double throughput = 0.0;
+	int built = 0;
+	int total = 0;
+};
+
+struct Candidate {
+	SchedulerPolicy policy;
+	double makespan = 0.0;   // 各种子的平均
+	double throughput = 0.0;
+	int unfinished = 0;      // 没建完的种子数
+};
+
+// 一次无头模拟：复制布局，建树、调度器与工人，不写日志，建成事件记 tick，全部建成或到 horizon 为止
+Outcome simulate(const WorldState& layout, const std::map<int, double>& weights, const SchedulerPolicy& policy, int workers, int horizon) {
+	WorldState world(layout);
+	TaskTree tree;
+	tree.setPriorityWeights(weights);
+	tree.buildFromDatabase(world.getCraftingSystem(), world.getBuildings());
+	Scheduler scheduler(world);
+	scheduler.setPolicy(policy);
+	std::vector<Agent*> agents = initDefaultWorkers(workers, &world.getCraftingSystem());
+
+	Outcome out;
+	for (std::map<int, Building>::const_iterator it = world.getBuildings().begin(); it != world.getBuildings().end(); ++it) {
+		if (it->first != 256) out.total++;
+	}
+	std::map<int, int> built_at;
+	{
+		Simulator sim(world, tree, scheduler, agents);
+		sim.setLogPath(std::string());
+		sim.setEventCallback([&built_at](const SimEvent& ev) {
+			if (ev.type == 1 && ev.target_id != 256 && !built_at.count(ev.target_id)) built_at[ev.target_id] = ev.tick;
+		});
+		sim.begin();
+		const int chunk = 200;
+		for (int t = 0; t < horizon && static_cast<int>(built_at.size()) < out.total; t += chunk) {
+			sim.step(std::min(chunk, horizon - t));
+		}
+	}
+	for (size_t i = 0; i < agents.size(); ++i) delete agents[i];
+
+	out.built = static_cast<int>(built_at.size());
+	int last = 0;
+	for (std::map<int, int>::const_iterator it = built_at.begin(); it != built_at.end(); ++it) {
+		last = std::max(last, it->second);
+		out.throughput += static_cast<double>(horizon - it->second) / horizon;
+	}
+	if (out.built >= out.total) out.makespan = last;
+	else out.makespan = horizon + static_cast<double>(horizon) * (out.total - out.built) / std::max(1, out.total);
+	return out;
+}
+
+// 对数正态扰动每个正参数；非正的参数（关闭的开关）保持不变
+SchedulerPolicy perturb(const SchedulerPolicy& base, double sigma, std::mt19937& rng) {
+	std::normal_distribution<double> gauss(0.0, 1.0);
+	SchedulerPolicy p = base;
+	std::vector<std::pair<std::string, double> > params = policyParams(base);
+	for (size_t i = 0; i < params.size(); ++i) {
+		if (params[i].second <= 0.0) continue;
+		setPolicyParam(p, params[i].first, params[i].second * std::exp(sigma * gauss(rng)));
+	}
+	return p;
+}
+
+bool betterMakespan(const Candidate& a, const Candidate& b) {
+	return a.makespan != b.makespan ? a.makespan < b.makespan : a.throughput > b.throughput;
+}
+
+bool betterThroughput(const Candidate& a, const Candidate& b) {
+	return a.throughput != b.throughput ? a.throughput > b.throughput : a.makespan < b.makespan;
+}
+
+void printPolicy(const char* title, const Candidate& c, const Candidate& baseline) {
+	std::cout << "# best " << title << ": makespan=" << c.makespan << " (default " << baseline.makespan << ")"
+	          << " throughput=" << c.throughput << " (default " << baseline.throughput << ")"
+	          << " unfinished_seeds=" << c.unfinished << std::endl;
+	std::vector<std::pair<std::string, double> > params = policyParams(c.policy);
+	for (size_t i = 0; i < params.size(); ++i) std::cout << params[i].first << " " << params[i].second << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	int rounds = argc > 1 ? std::max(1, std::atoi(argv[1])) : 3;
+	int samples = argc > 2 ? std::max(2, std::atoi(argv[2])) : 12;
+	int seeds = argc > 3 ? std::max(1, std::atoi(argv[3])) : 3;
+	int threads = argc > 4 ? std::max(1, std::atoi(argv[4])) : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+	int workers = argc > 5 ? std::max(1, std::atoi(argv[5])) : 3;
+	int horizon = argc > 6 ? std::max(1, std::atoi(argv[6])) : 24000;
+
+	DatabaseManager db;
+	const char* paths[] = {"resources/game_data.db", "../resources/game_data.db"};
+	bool connected = false;
+	for (const char* p : paths) {
+		if (db.connect(p)) { connected = true; break; }
+	}
+	if (!connected) {
+		std::cerr << "无法连接数据库，检查路径是否正确。" << std::endl;
+		return 1;
+	}
+	db.enable_performance_mode();
+	db.create_indexes();
+	if (!db.initialize_all_data()) {
+		std::cerr << "加载数据库失败。" << std::endl;
+		return 1;
+	}
+
+	std::map<int, double> weights;
+	{
+		std::ifstream fin("resources/priority_weights.txt");
+		std::string line;
+		while (fin.is_open() && std::getline(fin, line)) {
+			if (line.empty() || line[0] == '#') continue;
+			std::istringstream iss(line);
+			int id;
+			double w;
+			if (iss >> id >> w) weights[id] = w;
+		}
+	}
+
+	// 布局在主线程生成一次，各次模拟只复制，线程中不再访问数据库
+	std::vector<WorldState> layouts;
+	for (int s = 0; s < seeds; ++s) {
+		layouts.push_back(WorldState(db));
+		layouts.back().CreateRandomWorld(2000, 2000, 114514u + static_cast<unsigned>(s));
+	}
+
+	// 一批候选 × 种子的模拟分给线程池，结果按候选取平均
+	long long runs = 0;
+	auto evaluate = [&](std::vector<Candidate>& batch) {
+		size_t jobs = batch.size() * layouts.size();
+		std::vector<Outcome> results(jobs);
+		std::atomic<size_t> next(0);
+		auto work = [&]() {
+			for (size_t j = next.fetch_add(1); j < jobs; j = next.fetch_add(1)) {
+				results[j] = simulate(layouts[j % layouts.size()], weights, batch[j / layouts.size()].policy, workers, horizon);
+			}
+		};
+		std::vector<std::thread> pool;
+		for (int i = 1; i < threads && i < static_cast<int>(jobs); ++i) pool.push_back(std::thread(work));
+		work();
+		for (size_t i = 0; i < pool.size(); ++i) pool[i].join();
+		for (size_t c = 0; c < batch.size(); ++c) {
+			batch[c].makespan = batch[c].throughput = 0.0;
+			batch[c].unfinished = 0;
+			for (size_t s = 0; s < layouts.size(); ++s) {
+				const Outcome& o = results[c * layouts.size() + s];
+				batch[c].makespan += o.makespan / layouts.size();
+				batch[c].throughput += o.throughput / layouts.size();
+				if (o.built < o.total) batch[c].unfinished++;
+			}
+		}
+		runs += static_cast<long long>(jobs);
+	};
+
+	std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+	std::mt19937 rng(2025);
+	std::vector<Candidate> first(1);
+	evaluate(first);
+	const Candidate baseline = first[0];
+	Candidate best_makespan = baseline;
+	Candidate best_throughput = baseline;
+	double sigma = 0.5;
+	for (int r = 0; r < rounds; ++r) {
+		std::vector<Candidate> batch(samples);
+		for (int i = 0; i < samples; ++i) {
+			const Candidate& center = (i % 2 == 0) ? best_makespan : best_throughput;
+			batch[i].policy = perturb(center.policy, sigma, rng);
+		}
+		evaluate(batch);
+		for (size_t i = 0; i < batch.size(); ++i) {
+			if (betterMakespan(batch[i], best_makespan)) best_makespan = batch[i];
+			if (betterThroughput(batch[i], best_throughput)) best_throughput = batch[i];
+		}
+		std::cout << "round " << r + 1 << "/" << rounds << ": sigma=" << sigma
+		          << " best makespan=" << best_makespan.makespan << " best throughput=" << best_throughput.throughput << std::endl;
+		sigma *= 0.5;
+	}
+	long long ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+	std::cout << runs << " simulations (" << seeds << " seeds, " << workers << " workers, horizon " << horizon
+	          << ") on " << threads << " threads in " << ms << " ms" << std::endl;
+	printPolicy("makespan", best_makespan, baseline);
+	printPolicy("throughput", best_throughput, baseline);
+	return 0;
+}
@@ -0,0 +1,171 @@
+// ServiceBench: 调度服务的本地压测客户端
+// 用法：ServiceBench <socket> [sessions=8] [rounds=200] [agents=3]
+// 每轮对每个会话流水线发送一帧增量（工人移动、上一轮任务结束）和一帧分配请求，
+// 最后打印客户端往返延迟与服务端统计。
+#include "ServiceProtocol.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+long long nowMicros() {
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+	    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool sendAll(int fd, const std::vector<unsigned char>& buf) {
+	size_t sent = 0;
+	while (sent < buf.size()) {
+		ssize_t n = send(fd, buf.data() + sent, buf.size() - sent, MSG_NOSIGNAL);
+		if (n <= 0) return false;
+		sent += static_cast<size_t>(n);
+	}
+	return true;
+}
+
+bool recvAll(int fd, unsigned char* p, size_t len) {
+	size_t got = 0;
+	while (got < len) {
+		ssize_t n = recv(fd, p + got, len - got, 0);
+		if (n <= 0) return false;
+		got += static_cast<size_t>(n);
+	}
+	return true;
+}
+
+bool readFrame(int fd, svc::FrameHeader& h, std::vector<unsigned char>& payload) {
+	unsigned char head[svc::kHeaderSize];
+	if (!recvAll(fd, head, sizeof(head))) return false;
+	h = svc::decodeHeader(head);
+	if (h.length > svc::kMaxPayload) return false;
+	payload.resize(h.length);
+	return h.length == 0 || recvAll(fd, payload.data(), h.length);
+}
+
+void queueFrame(std::vector<unsigned char>& out, uint16_t op, uint32_t rid, uint32_t session,
+                const std::vector<unsigned char>& payload) {
+	svc::FrameHeader h;
+	h.op = op;
+	h.request_id = rid;
+	h.session_id = session;
+	svc::encodeFrame(out, h, payload);
+}
+
+long long percentile(const std::vector<long long>& sorted, int p) {
+	if (sorted.empty()) return 0;
+	return sorted[(sorted.size() * p + 99) / 100 - 1];
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+	if (argc < 2) {
+		std::cerr << "usage: ServiceBench <socket> [sessions] [rounds] [agents]" << std::endl;
+		return 1;
+	}
+	int sessions = argc > 2 ? std::max(1, std::atoi(argv[2])) : 8;
+	int rounds = argc > 3 ? std::max(1, std::atoi(argv[3])) : 200;
+	int agents = argc > 4 ? std::max(1, std::atoi(argv[4])) : 3;
+
+	sockaddr_un addr;
+	std::memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	std::strncpy(addr.sun_path, argv[1], sizeof(addr.sun_path) - 1);
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+		std::cerr << "cannot connect to " << argv[1] << std::endl;
+		return 1;
+	}
+
+	uint32_t next_rid = 1;
+	std::map<uint32_t, long long> sent_at;
+	std::vector<long long> rtt;
+	svc::FrameHeader h;
+	std::vector<unsigned char> payload;
+
+	// 创建会话
+	std::vector<uint32_t> ids;
+	std::vector<unsigned char> out;
+	for (int s = 0; s < sessions; ++s) {
+		std::vector<unsigned char> p;
+		svc::putI32(p, 2000);
+		svc::putI32(p, 2000);
+		svc::putI32(p, agents);
+		queueFrame(out, svc::OpCreate, next_rid++, 0, p);
+	}
+	if (!sendAll(fd, out)) return 1;
+	for (int s = 0; s < sessions; ++s) {
+		if (!readFrame(fd, h, payload) || h.status != svc::StatusOk) {
+			std::cerr << "create failed" << std::endl;
+			return 1;
+		}
+		ids.push_back(h.session_id);
+	}
+
+	std::mt19937 rng(7);
+	std::uniform_int_distribution<int> coord(0, 1999);
+	long long t0 = nowMicros();
+	int assignments = 0;
+	for (int r = 0; r < rounds; ++r) {
+		out.clear();
+		long long now = nowMicros();
+		for (size_t s = 0; s < ids.size(); ++s) {
+			std::vector<unsigned char> delta;
+			for (int a = 0; a < agents; ++a) {
+				svc::putI32(delta, svc::DeltaAgentMove);
+				svc::putI32(delta, a);
+				svc::putI32(delta, coord(rng));
+				svc::putI32(delta, coord(rng));
+				svc::putI32(delta, svc::DeltaAgentDone);
+				svc::putI32(delta, a);
+				svc::putI32(delta, 0);
+				svc::putI32(delta, 0);
+			}
+			sent_at[next_rid] = now;
+			queueFrame(out, svc::OpDelta, next_rid++, ids[s], delta);
+			sent_at[next_rid] = now;
+			queueFrame(out, svc::OpAssign, next_rid++, ids[s], std::vector<unsigned char>());
+		}
+		if (!sendAll(fd, out)) return 1;
+		for (size_t i = 0; i < ids.size() * 2; ++i) {
+			if (!readFrame(fd, h, payload)) return 1;
+			rtt.push_back(nowMicros() - sent_at[h.request_id]);
+			sent_at.erase(h.request_id);
+			if (h.op == (svc::OpAssign | svc::OpReply)) assignments += static_cast<int>(payload.size() / 16);
+		}
+	}
+	long long elapsed = nowMicros() - t0;
+
+	out.clear();
+	queueFrame(out, svc::OpStats, next_rid++, 0, std::vector<unsigned char>());
+	for (size_t s = 0; s < ids.size(); ++s) queueFrame(out, svc::OpDestroy, next_rid++, ids[s], std::vector<unsigned char>());
+	if (!sendAll(fd, out)) return 1;
+	std::vector<long long> server(5, 0);
+	for (size_t i = 0; i < ids.size() + 1; ++i) {
+		if (!readFrame(fd, h, payload)) return 1;
+		if (h.op == (svc::OpStats | svc::OpReply) && payload.size() >= 20) {
+			for (int k = 0; k < 5; ++k) server[k] = svc::getU32(&payload[k * 4]);
+		}
+	}
+	close(fd);
+
+	std::sort(rtt.begin(), rtt.end());
+	std::cout << sessions << " sessions x " << rounds << " rounds: " << rtt.size() << " requests, "
+	          << assignments << " assignments in " << elapsed / 1000 << " ms ("
+	          << (elapsed > 0 ? rtt.size() * 1000000LL / elapsed : 0) << " req/s)" << std::endl;
+	std::cout << "client rtt: p50=" << percentile(rtt, 50) << "us p90=" << percentile(rtt, 90)
+	          << "us p99=" << percentile(rtt, 99) << "us max=" << (rtt.empty() ? 0 : rtt.back()) << "us" << std::endl;
+	std::cout << "server (" << server[0] << " replies): p50=" << server[1] << "us p90=" << server[2]
+	          << "us p99=" << server[3] << "us max=" << server[4] << "us" << std::endl;
+	return 0;
+}